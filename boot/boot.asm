@@ -5,7 +5,8 @@
 ; 1. Is loaded by BIOS at address 0x7C00
 ; 2. Switches from 16-bit real mode to 32-bit protected mode
 ; 3. Loads the kernel from disk
-; 4. Jumps to the kernel
+; 4. Collects the BIOS E820 memory map
+; 5. Jumps to the kernel (EBX = address of the memory map)
 ; ============================================================================
 
 [bits 16]
@@ -13,6 +14,10 @@
 
 KERNEL_OFFSET equ 0x10000   ; 64KB mark (safe from bootloader overwrite)
                                 ; Matches linker.ld address
+KERNEL_SECTORS equ 256      ; Sectors loaded for the kernel (128 KB)
+SECTORS_PER_READ equ 64     ; Per BIOS call: 32 KB, within one 64 KB segment
+E820_MAP      equ 0x5000    ; Memory map: dword count, then 24-byte entries
+E820_MAX_ENTRIES equ 32     ; Matches kernel/memmap.h
 
 ; Entry point
 start:
@@ -32,6 +37,9 @@ start:
     ; Load kernel from disk
     call load_kernel
 
+    ; Ask the BIOS where the RAM is
+    call detect_memory
+
     ; Switch to 32-bit protected mode
     call switch_to_pm
 
@@ -71,28 +79,54 @@ load_kernel:
     int 0x13
     jc lba_error            ; LBA not supported
     
-    ; Setup Disk Address Packet (DAP)
-    mov word [dap_size], 0x0010
-    mov word [dap_count], 127
-    mov word [dap_offset], 0x0000       ; Offset 0
-    mov word [dap_segment], 0x1000      ; Segment 0x1000 (Physical: 0x10000)
-    mov dword [dap_lba], 1
-    mov dword [dap_lba_high], 0
-
+    ; Many BIOSes move at most 127 sectors per call, so read in pieces,
+    ; advancing the Disk Address Packet (DAP) after each one
+    mov cx, KERNEL_SECTORS / SECTORS_PER_READ
+.next:
+    push cx
     mov si, dap_size
     mov ah, 0x42
     mov dl, [BOOT_DRIVE]
     int 0x13
+    pop cx
     jc read_error
+    add word [dap_segment], SECTORS_PER_READ * 512 / 16
+    add dword [dap_lba], SECTORS_PER_READ
+    loop .next
     
     ret
 
+; Collect the E820 memory map at E820_MAP (count 0 if unsupported)
+detect_memory:
+    mov di, E820_MAP + 4    ; ES:DI = first entry
+    xor ebx, ebx            ; Continuation value, 0 = start
+    xor bp, bp              ; Entry count
+.next:
+    mov eax, 0xE820
+    mov edx, 0x534D4150     ; 'SMAP'
+    mov ecx, 24
+    mov dword [di + 20], 1  ; Valid ACPI 3.0 attributes if BIOS leaves them
+    int 0x15
+    jc .done                ; Unsupported, or past the last entry
+    cmp eax, 0x534D4150
+    jne .done
+    inc bp
+    add di, 24
+    test ebx, ebx           ; 0 = that was the last entry
+    jz .done
+    cmp bp, E820_MAX_ENTRIES
+    jb .next
+.done:
+    movzx ebp, bp
+    mov [E820_MAP], ebp
+    ret
+
 dap_size:       db 0x10
 dap_reserved:   db 0x00
-dap_count:      dw 0x0000
-dap_offset:     dw 0x0000
-dap_segment:    dw 0x0000
-dap_lba:        dd 0x00000000
+dap_count:      dw SECTORS_PER_READ
+dap_offset:     dw 0x0000       ; Offset 0
+dap_segment:    dw 0x1000       ; Segment 0x1000 (Physical: 0x10000)
+dap_lba:        dd 0x00000001   ; Kernel starts right after the boot sector
 dap_lba_high:   dd 0x00000000
 
 lba_error:
@@ -186,7 +220,8 @@ init_pm:
     mov edi, 0xB8000 + 160  ; Second line of video memory
     call print_string_32
 
-    ; Jump to kernel
+    ; Jump to kernel, handing it the memory map
+    mov ebx, E820_MAP
     call KERNEL_OFFSET
 
     jmp $                   ; Hang if kernel returns
@@ -0,0 +1,131 @@
+/*
+ * ============================================================================
+ * Arena Allocator Implementation
+ * ============================================================================
+ * Scoped bump allocator for MyOS.
+ *
+ * An arena hands out memory by bumping a pointer inside large chunks taken
+ * from malloc(). Nothing is freed individually: arena_mark() saves the
+ * current position and arena_reset() rolls back to it, releasing every
+ * allocation made since (and any chunks added for them) in one step.
+ * ============================================================================
+ */
+
+#include "arena.h"
+#include "memory.h"
+
+/* Chunk header size, rounded so chunk data keeps ARENA_ALIGN */
+#define CHUNK_HEADER_SIZE                                                      \
+  ((sizeof(ArenaChunk) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+/* Largest request whose rounding and chunk header cannot wrap size_t */
+#define ARENA_MAX_SIZE ((size_t)-1 - CHUNK_HEADER_SIZE - ARENA_ALIGN)
+
+/* ============================================================================
+ * Internal Functions
+ * ============================================================================
+ */
+
+/* Push a fresh chunk with at least min_size usable bytes */
+static ArenaChunk *arena_grow(Arena *arena, size_t min_size) {
+  size_t size = arena->chunk_size;
+  if (size < min_size) {
+    size = min_size;
+  }
+  if (size > ARENA_MAX_SIZE)
+    return NULL;
+
+  ArenaChunk *chunk = (ArenaChunk *)malloc(CHUNK_HEADER_SIZE + size);
+  if (!chunk)
+    return NULL;
+
+  chunk->prev = arena->current;
+  chunk->size = size;
+  chunk->used = 0;
+  arena->current = chunk;
+
+  return chunk;
+}
+
+/* Start of a chunk's usable memory */
+static uint8_t *chunk_data(ArenaChunk *chunk) {
+  return (uint8_t *)chunk + CHUNK_HEADER_SIZE;
+}
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================
+ */
+
+/* Create an arena; its first chunk is allocated up front */
+Arena *arena_create(size_t chunk_size) {
+  Arena *arena = (Arena *)malloc(sizeof(Arena));
+  if (!arena)
+    return NULL;
+
+  arena->current = NULL;
+  arena->chunk_size = chunk_size ? chunk_size : ARENA_DEFAULT_CHUNK;
+
+  if (!arena_grow(arena, 0)) {
+    free(arena);
+    return NULL;
+  }
+
+  return arena;
+}
+
+/* Free an arena and all of its chunks */
+void arena_destroy(Arena *arena) {
+  if (!arena)
+    return;
+
+  ArenaChunk *chunk = arena->current;
+  while (chunk) {
+    ArenaChunk *prev = chunk->prev;
+    free(chunk);
+    chunk = prev;
+  }
+
+  free(arena);
+}
+
+/* Allocate from the arena (pointer bump in the common case) */
+void *arena_alloc(Arena *arena, size_t size) {
+  if (!arena || size == 0 || size > ARENA_MAX_SIZE)
+    return NULL;
+
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+  ArenaChunk *chunk = arena->current;
+  if (chunk->size - chunk->used < size) {
+    chunk = arena_grow(arena, size);
+    if (!chunk)
+      return NULL;
+  }
+
+  void *ptr = chunk_data(chunk) + chunk->used;
+  chunk->used += size;
+  return ptr;
+}
+
+/* Save the current allocation position (an empty mark for NULL) */
+ArenaMark arena_mark(Arena *arena) {
+  ArenaMark mark;
+  mark.chunk = arena ? arena->current : NULL;
+  mark.used = arena ? arena->current->used : 0;
+  return mark;
+}
+
+/* Roll back to a mark, dropping chunks added after it */
+void arena_reset(Arena *arena, ArenaMark mark) {
+  if (!arena || !mark.chunk)
+    return;
+
+  while (arena->current != mark.chunk) {
+    ArenaChunk *prev = arena->current->prev;
+    free(arena->current);
+    arena->current = prev;
+  }
+
+  arena->current->used = mark.used;
+}
@@ -0,0 +1,44 @@
+/*
+ * ============================================================================
+ * Arena Allocator Header
+ * ============================================================================
+ * Bump allocation for short-lived scratch memory that dies all at once
+ * ============================================================================
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "kernel.h"
+
+/* Arena configuration */
+#define ARENA_ALIGN 8                    /* Alignment of every arena_alloc() */
+#define ARENA_DEFAULT_CHUNK (64 * 1024)  /* Chunk size if 0 is passed */
+
+/* A heap chunk that allocations are bumped out of */
+typedef struct ArenaChunk {
+  struct ArenaChunk *prev; /* Older chunk of the same arena */
+  size_t size;             /* Usable bytes after this header */
+  size_t used;             /* Bytes handed out so far */
+} ArenaChunk;
+
+/* An arena: a stack of chunks, newest on top */
+typedef struct Arena {
+  ArenaChunk *current;     /* Chunk currently being bumped */
+  size_t chunk_size;       /* Default usable bytes per chunk */
+} Arena;
+
+/* A saved position, for arena_reset() */
+typedef struct ArenaMark {
+  ArenaChunk *chunk;
+  size_t used;
+} ArenaMark;
+
+/* Arena functions */
+Arena *arena_create(size_t chunk_size);
+void arena_destroy(Arena *arena);
+void *arena_alloc(Arena *arena, size_t size);
+ArenaMark arena_mark(Arena *arena);
+void arena_reset(Arena *arena, ArenaMark mark);
+
+#endif /* ARENA_H */
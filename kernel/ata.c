@@ -2,38 +2,145 @@
  * ============================================================================
  * ATA Disk Driver Implementation
  * ============================================================================
- * ATA PIO mode driver for reading sectors from disk.
- * Uses 28-bit LBA addressing (supports up to 128 GB).
+ * ATA driver for reading and writing sectors.
+ * 
+ * ata_init() sends IDENTIFY DEVICE to learn the drive's size and
+ * features. Drives with 48-bit LBA get the EXT commands, which address
+ * past 128 GB and move up to 65536 sectors per command; older drives use
+ * 28-bit commands of up to 256 sectors. If the drive supports READ/WRITE
+ * MULTIPLE, PIO commands use the largest block it offers, so the drive
+ * interrupts once per block instead of once per sector.
+ * 
+ * Every transfer is an AtaRequest on a queue. ata_submit() adds one and
+ * returns; the IRQ 14 handler moves the data, finishes the request
+ * (calling its callback) and issues the next command straight away, so
+ * a caller can work on one buffer while the next one is filling. The
+ * synchronous functions submit a request and halt in ata_wait().
+ * 
+ * If pci_init() found a bus-master IDE controller (the PIIX that QEMU
+ * emulates), requests use DMA: a PRD table lists the buffer in pieces
+ * that do not cross 64 KB boundaries and the controller moves the data,
+ * interrupting once per command. Otherwise, or once a DMA command has
+ * failed, the handler moves each sector by PIO as the drive asks.
+ * 
+ * The PIO data phase moves each sector with one rep insw
+ * (port_words_in()), not 256 calls to port_word_in(); ata_benchmark()
+ * compares these and DMA.
+ * 
+ * Writes go out as few multi-sector commands as possible and stay in
+ * the drive's write cache until ata_flush() is called.
  * 
  * Reference: https://wiki.osdev.org/ATA_PIO_Mode
  * ============================================================================
  */
 
 #include "ata.h"
+#include "interrupt.h"
+#include "memory.h"
+#include "pci.h"
+#include "printf.h"
 #include "screen.h"
+#include "timer.h"
+
+/* How long ata_wait_bsy() and ata_wait_drq() wait for the drive */
+#define ATA_WAIT_TIMEOUT_MS 1000
+
+/*
+ * Without a calibrated TSC, time_ms() only moves in IRQ 0, which cannot
+ * run while these waits hold interrupts off. They then also give up
+ * after this many status polls per millisecond of timeout (a poll is a
+ * port read, well over 100 ns, so the real limit is only ever longer).
+ */
+#define ATA_POLLS_PER_MS 10000
+
+#define WORDS_PER_SECTOR (ATA_SECTOR_SIZE / 2)
+
+/* How the data phase moves a sector */
+#define PIO_WORD_LOOP 0     /* port_word_in() per word */
+#define PIO_STRING16  1     /* rep insw */
+#define PIO_STRING32  2     /* rep insd */
+
+static int pio_mode = PIO_STRING16;
+
+/* One Physical Region Descriptor: a piece of the transfer buffer */
+typedef struct {
+    uint32_t address;       /* Physical, word aligned */
+    uint16_t bytes;         /* 0 means 64 KB */
+    uint16_t flags;
+} __attribute__((packed)) PrdEntry;
+
+#define PRD_EOT          0x8000      /* Last entry of the table */
+#define PRD_BOUNDARY     0x10000     /* No entry may cross a 64 KB line */
+
+/* Enough entries for the largest command at any buffer alignment */
+#define PRD_ENTRIES (ATA_MAX_SECTORS_EXT * ATA_SECTOR_SIZE / PRD_BOUNDARY + 1)
+
+/* Time a started request may go without progress before it is abandoned */
+#define ATA_REQUEST_TIMEOUT_MS 5000
+
+/* The table itself must not cross 64 KB either; aligning it to a power
+ * of two larger than itself ensures that */
+static PrdEntry prd_table[PRD_ENTRIES] __attribute__((aligned(8192)));
+
+static AtaDriveInfo drive;
+
+static bool dma_enabled = false;
+static uint16_t bm_base = 0;            /* Bus-master registers (BAR4) */
+static volatile uint32_t dma_failures = 0;  /* DMA commands redone by PIO */
+static uint32_t dma_failures_reported = 0;
+
+/* Request queue: the head is the command the drive is working on */
+static AtaRequest* volatile queue_head = NULL;
+static AtaRequest* volatile queue_tail = NULL;
+static bool head_started = false;       /* Command for the head was issued */
+static bool head_dma = false;           /* ... and it went by DMA */
+static uint32_t head_progress_ms;       /* When the head last moved or arrived */
+static uint32_t head_polls;             /* Timeout checks since then */
+static uint8_t* pio_buffer;             /* Next sector of a PIO head request */
+static uint32_t pio_left;               /* Sectors still to move by PIO */
+static uint32_t pio_block;              /* Sectors per DRQ for the head */
 
-/* Timeout for ATA operations (in iterations) */
-#define ATA_TIMEOUT 100000
+/* Sectors read per ata_benchmark() run */
+#define BENCH_SECTORS 2048
+
+/* ata_benchmark() rows after the PIO modes */
+#define BENCH_DMA    3
+#define BENCH_QUEUED 4      /* All commands submitted up front */
 
 /* ============================================================================
  * Internal Functions
  * ============================================================================ */
 
+/*
+ * The two waits below spin, so they are for task context only; the
+ * IRQ 14 path checks the status once and comes back later instead.
+ */
+
+/* Has a wait that began at start_ms and has polled polls times run out? */
+static bool ata_timed_out(uint32_t start_ms, uint32_t polls, uint32_t limit_ms) {
+    if (time_ms() - start_ms > limit_ms) return true;
+    return timer_tsc_khz() == 0 && polls > limit_ms * ATA_POLLS_PER_MS;
+}
+
 /* Wait for BSY flag to clear */
 static int ata_wait_bsy(void) {
-    int timeout = ATA_TIMEOUT;
-    while ((port_byte_in(ATA_PRIMARY_STATUS) & ATA_STATUS_BSY) && timeout > 0) {
-        timeout--;
+    uint32_t start = time_ms();
+    uint32_t polls = 0;
+    while (port_byte_in(ATA_PRIMARY_STATUS) & ATA_STATUS_BSY) {
+        if (ata_timed_out(start, ++polls, ATA_WAIT_TIMEOUT_MS)) {
+            return ATA_ERR_TIMEOUT;
+        }
     }
-    return timeout > 0 ? ATA_SUCCESS : ATA_ERR_TIMEOUT;
+    return ATA_SUCCESS;
 }
 
 /* Wait for DRQ flag to set (data ready) */
 static int ata_wait_drq(void) {
-    int timeout = ATA_TIMEOUT;
+    uint32_t start = time_ms();
+    uint32_t polls = 0;
     uint8_t status;
     
-    while (timeout > 0) {
+    while (!ata_timed_out(start, polls++, ATA_WAIT_TIMEOUT_MS)) {
         status = port_byte_in(ATA_PRIMARY_STATUS);
         
         if (status & ATA_STATUS_ERR) {
@@ -42,12 +149,31 @@ static int ata_wait_drq(void) {
         if (status & ATA_STATUS_DRQ) {
             return ATA_SUCCESS;
         }
-        timeout--;
     }
     
     return ATA_ERR_TIMEOUT;
 }
 
+/* Transfer a block of sectors from the data port */
+static void pio_read_block(void* buffer, uint32_t sectors) {
+    uint16_t* buf = (uint16_t*)buffer;
+    uint32_t words = sectors * WORDS_PER_SECTOR;
+    
+    switch (pio_mode) {
+        case PIO_WORD_LOOP:
+            for (uint32_t i = 0; i < words; i++) {
+                buf[i] = port_word_in(ATA_PRIMARY_DATA);
+            }
+            break;
+        case PIO_STRING32:
+            port_dwords_in(ATA_PRIMARY_DATA, buf, words / 2);
+            break;
+        default:
+            port_words_in(ATA_PRIMARY_DATA, buf, words);
+            break;
+    }
+}
+
 /* 400ns delay (read status port 4 times) */
 static void ata_delay(void) {
     port_byte_in(ATA_PRIMARY_STATUS);
@@ -56,11 +182,407 @@ static void ata_delay(void) {
     port_byte_in(ATA_PRIMARY_STATUS);
 }
 
+/* Wait for BSY to clear after a command, reporting ERR as error */
+static int ata_wait_done(int error) {
+    if (ata_wait_bsy() != ATA_SUCCESS) {
+        return ATA_ERR_TIMEOUT;
+    }
+    return (port_byte_in(ATA_PRIMARY_STATUS) & ATA_STATUS_ERR) ? error : ATA_SUCCESS;
+}
+
+/*
+ * Program the task file for an LBA command and issue it; the drive must
+ * not be busy. A count of ATA_MAX_SECTORS (or ATA_MAX_SECTORS_EXT) goes
+ * out as 0.
+ */
+static void ata_send_command(uint32_t lba, uint32_t count, uint8_t command) {
+    if (drive.lba48) {
+        /* 0x40 = master drive, LBA mode; the LBA is all in the task file */
+        port_byte_out(ATA_PRIMARY_DRIVE_HEAD, 0x40);
+        ata_delay();
+        
+        /* Each register holds two bytes: write the high ones first */
+        port_byte_out(ATA_PRIMARY_SECCOUNT, (uint8_t)(count >> 8));
+        port_byte_out(ATA_PRIMARY_LBA_LO, (uint8_t)(lba >> 24));
+        port_byte_out(ATA_PRIMARY_LBA_MID, 0);
+        port_byte_out(ATA_PRIMARY_LBA_HI, 0);
+    } else {
+        /* Select drive and send high LBA bits */
+        /* 0xE0 = master drive, LBA mode */
+        port_byte_out(ATA_PRIMARY_DRIVE_HEAD, 0xE0 | ((lba >> 24) & 0x0F));
+        ata_delay();
+    }
+    
+    /* Send sector count */
+    port_byte_out(ATA_PRIMARY_SECCOUNT, (uint8_t)count);
+    
+    /* Send LBA address (low 24 bits) */
+    port_byte_out(ATA_PRIMARY_LBA_LO, (uint8_t)(lba & 0xFF));
+    port_byte_out(ATA_PRIMARY_LBA_MID, (uint8_t)((lba >> 8) & 0xFF));
+    port_byte_out(ATA_PRIMARY_LBA_HI, (uint8_t)((lba >> 16) & 0xFF));
+    
+    port_byte_out(ATA_PRIMARY_COMMAND, command);
+}
+
+/* The read or write command for a transfer by DMA or PIO */
+static uint8_t pick_command(bool write, bool dma) {
+    if (dma) {
+        if (drive.lba48) return write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT;
+        return write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA;
+    }
+    if (drive.multiple) {
+        if (drive.lba48) return write ? ATA_CMD_WRITE_MULTIPLE_EXT : ATA_CMD_READ_MULTIPLE_EXT;
+        return write ? ATA_CMD_WRITE_MULTIPLE : ATA_CMD_READ_MULTIPLE;
+    }
+    if (drive.lba48) return write ? ATA_CMD_WRITE_SECTORS_EXT : ATA_CMD_READ_SECTORS_EXT;
+    return write ? ATA_CMD_WRITE_SECTORS : ATA_CMD_READ_SECTORS;
+}
+
+/* Copy an IDENTIFY string (two characters per word, high byte first) */
+static void identify_string(char* out, const uint16_t* words, int count) {
+    int len = 0;
+    for (int i = 0; i < count; i++) {
+        out[len++] = (char)(words[i] >> 8);
+        out[len++] = (char)(words[i] & 0xFF);
+    }
+    while (len > 0 && out[len - 1] == ' ') len--;
+    out[len] = '\0';
+}
+
+/* Ask the primary master what it is; fills drive */
+static void ata_identify(void) {
+    uint16_t id[256];
+    
+    memset(&drive, 0, sizeof(drive));
+    
+    port_byte_out(ATA_PRIMARY_DRIVE_HEAD, 0xA0);
+    ata_delay();
+    port_byte_out(ATA_PRIMARY_SECCOUNT, 0);
+    port_byte_out(ATA_PRIMARY_LBA_LO, 0);
+    port_byte_out(ATA_PRIMARY_LBA_MID, 0);
+    port_byte_out(ATA_PRIMARY_LBA_HI, 0);
+    port_byte_out(ATA_PRIMARY_COMMAND, ATA_CMD_IDENTIFY);
+    
+    /* Status 0 (or a floating bus) means there is no drive */
+    uint8_t status = port_byte_in(ATA_PRIMARY_STATUS);
+    if (status == 0 || status == 0xFF || ata_wait_bsy() != ATA_SUCCESS) {
+        return;
+    }
+    
+    /* ATAPI and SATA devices answer with a signature instead */
+    if (port_byte_in(ATA_PRIMARY_LBA_MID) || port_byte_in(ATA_PRIMARY_LBA_HI)) {
+        return;
+    }
+    if (ata_wait_drq() != ATA_SUCCESS) {
+        return;
+    }
+    port_words_in(ATA_PRIMARY_DATA, id, 256);
+    
+    drive.present = true;
+    identify_string(drive.serial, id + 10, 10);
+    identify_string(drive.firmware, id + 23, 4);
+    identify_string(drive.model, id + 27, 20);
+    drive.cylinders = id[1];
+    drive.heads = id[3];
+    drive.sectors_per_track = id[6];
+    drive.dma = (id[49] & (1 << 8)) != 0;
+    drive.max_multiple = id[47] & 0xFF;
+    drive.lba48 = (id[83] & (1 << 10)) != 0;
+    
+    drive.sectors = id[60] | ((uint32_t)id[61] << 16);
+    if (drive.lba48) {
+        uint32_t high = id[102] | id[103];
+        drive.sectors = high ? 0xFFFFFFFF : id[100] | ((uint32_t)id[101] << 16);
+    }
+}
+
+/* Turn on READ/WRITE MULTIPLE with the largest block the drive offers */
+static void ata_set_multiple(void) {
+    if (drive.max_multiple <= 1 || ata_wait_bsy() != ATA_SUCCESS) {
+        return;
+    }
+    port_byte_out(ATA_PRIMARY_DRIVE_HEAD, 0xA0);
+    ata_delay();
+    port_byte_out(ATA_PRIMARY_SECCOUNT, drive.max_multiple);
+    port_byte_out(ATA_PRIMARY_COMMAND, ATA_CMD_SET_MULTIPLE);
+    ata_delay();
+    
+    if (ata_wait_done(ATA_ERR_WRITE) == ATA_SUCCESS) {
+        drive.multiple = drive.max_multiple;
+    }
+}
+
+/*
+ * Clear those of the given write-1-to-clear status bits that were set;
+ * returns the old status. Writing 1 to a bit that read as clear would
+ * drop an interrupt raised between the read and the write.
+ */
+static uint8_t bm_ack(uint8_t bits) {
+    uint8_t status = port_byte_in(bm_base + ATA_BM_STATUS);
+    uint8_t keep = status & ~(ATA_BM_STATUS_ERROR | ATA_BM_STATUS_IRQ);
+    port_byte_out(bm_base + ATA_BM_STATUS, keep | (status & bits));
+    return status;
+}
+
+/* True if a transfer into buffer can go by DMA */
+static bool dma_usable(const void* buffer) {
+    return dma_enabled && ((uint32_t)buffer & 1) == 0;
+}
+
+/*
+ * A DMA command failed in the bus-master engine or timed out: the
+ * controller does not really support it, so use PIO from now on.
+ */
+static void dma_failed(void) {
+    dma_enabled = false;
+    dma_failures++;
+}
+
+/* Announce a DMA failure; the handler cannot print, so task context does */
+static void report_dma_failures(void) {
+    if (dma_failures == dma_failures_reported) return;
+    dma_failures_reported = dma_failures;
+    screen_print_color("ATA: DMA failed, falling back to PIO\n", ERROR_COLOR);
+}
+
+/* Describe the buffer in the PRD table and start a DMA command */
+static void dma_start(AtaRequest* req) {
+    uint32_t bytes = req->count * ATA_SECTOR_SIZE;
+    uint32_t address = (uint32_t)req->buffer;   /* Kernel memory is identity mapped */
+    uint8_t direction = req->write ? 0 : ATA_BM_CMD_READ;
+    int entries = 0;
+    
+    /* Split the buffer at 64 KB boundaries */
+    while (bytes > 0) {
+        uint32_t chunk = PRD_BOUNDARY - (address & (PRD_BOUNDARY - 1));
+        if (chunk > bytes) chunk = bytes;
+        
+        prd_table[entries].address = address;
+        prd_table[entries].bytes = (uint16_t)chunk;
+        prd_table[entries].flags = 0;
+        entries++;
+        
+        address += chunk;
+        bytes -= chunk;
+    }
+    prd_table[entries - 1].flags = PRD_EOT;
+    
+    port_byte_out(bm_base + ATA_BM_COMMAND, direction);
+    bm_ack(ATA_BM_STATUS_ERROR | ATA_BM_STATUS_IRQ);
+    port_dword_out(bm_base + ATA_BM_PRDT, (uint32_t)prd_table);
+    
+    ata_send_command(req->lba, req->count, pick_command(req->write, true));
+    port_byte_out(bm_base + ATA_BM_COMMAND, direction | ATA_BM_CMD_START);
+}
+
+/* Move the next block of a PIO request through the data port */
+static void pio_transfer_block(bool write) {
+    uint32_t sectors = pio_left < pio_block ? pio_left : pio_block;
+    
+    if (write) {
+        port_words_out(ATA_PRIMARY_DATA, pio_buffer, sectors * WORDS_PER_SECTOR);
+    } else {
+        pio_read_block(pio_buffer, sectors);
+    }
+    pio_buffer += sectors * ATA_SECTOR_SIZE;
+    pio_left -= sectors;
+    ata_delay();
+}
+
+/*
+ * Issue a PIO command. A write's first block goes as soon as the drive
+ * asks for it; no interrupt announces that, so if DRQ is not up yet the
+ * next queue_service() call hands the block over instead.
+ */
+static void pio_start(AtaRequest* req) {
+    pio_buffer = (uint8_t*)req->buffer;
+    pio_left = req->count;
+    pio_block = drive.multiple ? drive.multiple : 1;
+    
+    ata_send_command(req->lba, req->count, pick_command(req->write, false));
+    
+    if (req->write) {
+        ata_delay();
+        if (port_byte_in(ATA_PRIMARY_ALT_STATUS) & ATA_STATUS_DRQ) {
+            pio_transfer_block(true);
+        }
+    }
+}
+
+/* The head request moved or reached the front: restart its timeout */
+static void head_progress(void) {
+    head_progress_ms = time_ms();
+    head_polls = 0;
+}
+
+/*
+ * Issue the command for the head request, if there is one waiting. A
+ * drive still BSY is left alone; a later queue_service() call (or the
+ * timeout) deals with the head then.
+ */
+static void queue_start(void) {
+    AtaRequest* req = queue_head;
+    
+    if (!req || head_started) return;
+    if (port_byte_in(ATA_PRIMARY_ALT_STATUS) & ATA_STATUS_BSY) return;
+    
+    head_started = true;
+    head_dma = dma_usable(req->buffer);
+    head_progress();
+    
+    if (head_dma) {
+        dma_start(req);
+    } else {
+        pio_start(req);
+    }
+}
+
+/*
+ * Take the head request off the queue, start the next one so the drive
+ * works while the callback runs, then report the result
+ */
+static void queue_finish(int result) {
+    AtaRequest* req = queue_head;
+    
+    queue_head = req->next;
+    if (!queue_head) queue_tail = NULL;
+    req->next = NULL;
+    head_started = false;
+    head_progress();
+    queue_start();
+    
+    req->status = result;
+    if (req->callback) {
+        req->callback(req);
+    }
+}
+
+/* The DMA head request failed: stop the engine and redo it by PIO */
+static void dma_retry_pio(void) {
+    port_byte_out(bm_base + ATA_BM_COMMAND, 0);
+    bm_ack(ATA_BM_STATUS_ERROR | ATA_BM_STATUS_IRQ);
+    dma_failed();
+    head_started = false;
+}
+
+/*
+ * Advance the head request as far as the drive allows. Runs from IRQ 14,
+ * and from ata_wait() and ata_poll() to catch up on anything an interrupt
+ * did not report; either way with interrupts disabled. Hardware state
+ * decides what to do, so an extra call is harmless.
+ */
+static void queue_service(void) {
+    AtaRequest* req = queue_head;
+    
+    if (!req || !head_started) {
+        /* Reading the status register acknowledges the drive */
+        port_byte_in(ATA_PRIMARY_STATUS);
+        if (bm_base) bm_ack(ATA_BM_STATUS_IRQ);
+        queue_start();
+        return;
+    }
+    
+    if (head_dma) {
+        uint8_t bm_status = bm_ack(ATA_BM_STATUS_IRQ);
+        uint8_t status = port_byte_in(ATA_PRIMARY_STATUS);
+        
+        /* The engine stops when the data has moved, the drive when
+         * it has answered; the IRQ bit alone may already be consumed */
+        bool failed = (bm_status & ATA_BM_STATUS_ERROR) || (status & ATA_STATUS_ERR);
+        bool moving = (bm_status & (ATA_BM_STATUS_ACTIVE | ATA_BM_STATUS_IRQ)) == ATA_BM_STATUS_ACTIVE;
+        if (!failed && (moving || (status & ATA_STATUS_BSY))) {
+            return;     /* Still transferring */
+        }
+        
+        port_byte_out(bm_base + ATA_BM_COMMAND, req->write ? 0 : ATA_BM_CMD_READ);
+        if (bm_status & ATA_BM_STATUS_ERROR) {
+            /* The controller could not move the data: PIO from now on */
+            dma_retry_pio();
+        } else if (status & ATA_STATUS_ERR) {
+            /* The drive refused the sectors; PIO would fare no better */
+            queue_finish(req->write ? ATA_ERR_WRITE : ATA_ERR_READ);
+        } else {
+            queue_finish(ATA_SUCCESS);
+        }
+    } else {
+        uint8_t status = port_byte_in(ATA_PRIMARY_STATUS);
+        
+        if (status & ATA_STATUS_BSY) return;
+        
+        if (status & ATA_STATUS_ERR) {
+            queue_finish(req->write ? ATA_ERR_WRITE : ATA_ERR_READ);
+        } else if (!req->write) {
+            /* Reads: each interrupt announces one block */
+            if (!(status & ATA_STATUS_DRQ)) return;
+            pio_transfer_block(false);
+            head_progress();
+            if (pio_left == 0) {
+                queue_finish(ATA_SUCCESS);
+            }
+        } else if (pio_left == 0) {
+            /* Writes: the last interrupt says the last block is done */
+            queue_finish(ATA_SUCCESS);
+        } else if (status & ATA_STATUS_DRQ) {
+            pio_transfer_block(true);
+            head_progress();
+        }
+    }
+    
+    queue_start();
+}
+
+/* Give up on a head request the drive has not taken or finished in time */
+static void queue_check_timeout(void) {
+    if (!queue_head) return;
+    if (!ata_timed_out(head_progress_ms, ++head_polls, ATA_REQUEST_TIMEOUT_MS)) return;
+    
+    /* Reset the drive so it takes the next command */
+    port_byte_out(ATA_PRIMARY_CONTROL, ATA_CONTROL_SRST);
+    ata_delay();
+    port_byte_out(ATA_PRIMARY_CONTROL, 0);
+    ata_wait_bsy();
+    
+    if (head_started && head_dma) {
+        dma_retry_pio();
+    } else {
+        queue_finish(ATA_ERR_TIMEOUT);
+    }
+    queue_start();
+}
+
+/* IRQ 14: the drive has data, wants data, or finished a command */
+static void ata_irq(InterruptFrame* frame) {
+    (void)frame;
+    queue_service();
+}
+
+/* Submit a request and wait for it */
+static int ata_transfer(uint32_t lba, uint32_t count, void* buffer, bool write) {
+    AtaRequest req;
+    
+    req.lba = lba;
+    req.count = count;
+    req.write = write;
+    req.buffer = buffer;
+    req.callback = NULL;
+    req.context = NULL;
+    ata_submit(&req);
+    return ata_wait(&req);
+}
+
+/* Wait until every queued request has finished */
+static void queue_drain(void) {
+    AtaRequest* last;
+    while ((last = queue_tail) != NULL) {
+        ata_wait(last);
+    }
+}
+
 /* ============================================================================
  * Public Functions
  * ============================================================================ */
 
-/* Initialize ATA driver */
+/* Initialize ATA driver (after pci_init()) */
 void ata_init(void) {
     /* Select primary master drive */
     port_byte_out(ATA_PRIMARY_DRIVE_HEAD, 0xA0);
@@ -68,59 +590,163 @@ void ata_init(void) {
     
     /* Soft reset - not strictly necessary but good practice */
     ata_wait_bsy();
+    
+    /* Find out what the drive can do (before IRQ 14 is unmasked) */
+    ata_identify();
+    ata_set_multiple();
+    
+    /* The request queue runs from IRQ 14; make sure the drive raises it */
+    queue_head = queue_tail = NULL;
+    head_started = false;
+    port_byte_out(ATA_PRIMARY_CONTROL, 0);
+    irq_register(IRQ_PRIMARY_ATA, ata_irq);
+    
+    /* Bus-master DMA needs a drive that supports it and an IDE
+     * controller with the bus-master BAR */
+    dma_enabled = false;
+    bm_base = 0;
+    const PciDevice* ide = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE);
+    if (drive.dma && ide && (ide->prog_if & PCI_IDE_BUS_MASTER) && (ide->bar[4] & PCI_BAR_IO)) {
+        bm_base = ide->bar[4] & PCI_BAR_IO_MASK;
+        pci_enable(ide, PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+        port_byte_out(bm_base + ATA_BM_COMMAND, 0);
+        bm_ack(ATA_BM_STATUS_ERROR | ATA_BM_STATUS_IRQ);
+        dma_enabled = true;
+    }
 }
 
-/*
- * Read sectors using 28-bit LBA PIO mode
- * 
- * lba:    Starting sector number (0-indexed)
- * count:  Number of sectors to read (1-255, 0 means 256)
- * buffer: Destination buffer (must be at least count * 512 bytes)
- * 
- * Returns: ATA_SUCCESS or error code
- */
-int ata_read_sectors(uint32_t lba, uint8_t count, void* buffer) {
-    if (count == 0) count = 1;
-    
-    uint16_t* buf = (uint16_t*)buffer;
+/* True if transfers currently use bus-master DMA */
+bool ata_dma_enabled(void) {
+    return dma_enabled;
+}
+
+/* Most sectors one request may transfer on this drive */
+uint32_t ata_max_sectors(void) {
+    return drive.lba48 ? ATA_MAX_SECTORS_EXT : ATA_MAX_SECTORS;
+}
+
+/* IDENTIFY results (present is false if there was no answer) */
+const AtaDriveInfo* ata_get_info(void) {
+    return &drive;
+}
+
+/* Print the drive's identity, size and how transfers are done */
+void ata_dump(void) {
+    report_dma_failures();
     
-    /* Wait for drive to be ready */
-    if (ata_wait_bsy() != ATA_SUCCESS) {
-        return ATA_ERR_TIMEOUT;
+    if (!drive.present) {
+        screen_print("Drive:    no IDENTIFY response\n");
+    } else {
+        kprintf("Model:    %s\n", drive.model);
+        kprintf("Serial:   %s  Firmware: %s\n", drive.serial, drive.firmware);
+        kprintf("Capacity: %u sectors (%u MB)\n", drive.sectors, drive.sectors / 2048);
+        kprintf("Geometry: %u cylinders, %u heads, %u sectors/track\n",
+                drive.cylinders, drive.heads, drive.sectors_per_track);
     }
     
-    /* Select drive and send high LBA bits */
-    /* 0xE0 = master drive, LBA mode */
-    port_byte_out(ATA_PRIMARY_DRIVE_HEAD, 0xE0 | ((lba >> 24) & 0x0F));
-    ata_delay();
+    kprintf("Mode:     %s, %s LBA, %u sectors per command\n",
+            dma_enabled ? "bus-master DMA" : "PIO", drive.lba48 ? "48-bit" : "28-bit",
+            ata_max_sectors());
+    if (drive.multiple) {
+        kprintf("PIO:      READ/WRITE MULTIPLE, %u sectors per interrupt\n", drive.multiple);
+    } else {
+        screen_print("PIO:      one sector per interrupt\n");
+    }
+    if (dma_failures) {
+        kprintf("DMA:      %u commands failed and were redone by PIO\n", dma_failures);
+    }
+}
+
+/*
+ * Queue a request. It starts as soon as the ones before it finish;
+ * req->status stays ATA_PENDING until then. The callback, if any, runs
+ * in interrupt context (see IrqHandler) and may submit more requests.
+ * req and its buffer must stay valid until the request completes.
+ * Returns: ATA_PENDING, or the error for a request that was rejected
+ *          (no drive, bad range); that one is not queued and its
+ *          callback is not called, but req->status holds the error too.
+ */
+int ata_submit(AtaRequest* req) {
+    req->next = NULL;
     
-    /* Send sector count */
-    port_byte_out(ATA_PRIMARY_SECCOUNT, count);
+    /* Sectors past the end of the drive, or past what 28-bit LBA reaches */
+    uint32_t end = drive.sectors;
+    if (!drive.lba48 && end > (1u << 28)) end = 1u << 28;
+    bool lba_ok = req->lba < end && req->count <= end - req->lba;
     
-    /* Send LBA address (low 24 bits) */
-    port_byte_out(ATA_PRIMARY_LBA_LO, (uint8_t)(lba & 0xFF));
-    port_byte_out(ATA_PRIMARY_LBA_MID, (uint8_t)((lba >> 8) & 0xFF));
-    port_byte_out(ATA_PRIMARY_LBA_HI, (uint8_t)((lba >> 16) & 0xFF));
+    if (!drive.present) {
+        req->status = ATA_ERR_NO_DRIVE;
+    } else if (req->count == 0 || req->count > ata_max_sectors() || !lba_ok) {
+        req->status = ATA_ERR_RANGE;
+    } else {
+        req->status = ATA_PENDING;
+    }
+    if (req->status != ATA_PENDING) {
+        return req->status;
+    }
     
-    /* Send read command */
-    port_byte_out(ATA_PRIMARY_COMMAND, ATA_CMD_READ_SECTORS);
+    uint32_t flags = irq_save();
+    if (queue_tail) {
+        queue_tail->next = req;
+    } else {
+        queue_head = req;
+        head_progress();
+    }
+    queue_tail = req;
+    queue_start();
+    irq_restore(flags);
+    return ATA_PENDING;
+}
+
+/*
+ * Check a request without blocking. This also moves the queue along
+ * where no interrupt does (interrupts disabled, a PIO write waiting to
+ * hand over its first block) and gives up on a request that timed out,
+ * so callers that only submit and poll should call it now and then.
+ */
+bool ata_poll(AtaRequest* req) {
+    uint32_t flags = irq_save();
+    queue_service();
+    queue_check_timeout();
+    irq_restore(flags);
+    report_dma_failures();
+    return req->status != ATA_PENDING;
+}
+
+/*
+ * Halt until a request completes (polling if interrupts are disabled)
+ * Returns: its status, ATA_SUCCESS or error code
+ */
+int ata_wait(AtaRequest* req) {
+    uint32_t flags = irq_save();
     
-    /* Read sectors */
-    for (int i = 0; i < count; i++) {
-        /* Wait for data to be ready */
-        if (ata_wait_drq() != ATA_SUCCESS) {
-            return ATA_ERR_READ;
+    while (req->status == ATA_PENDING) {
+        if (flags & EFLAGS_IF) {
+            wait_for_interrupt();
+            interrupts_disable();
         }
-        
-        /* Read 256 words (512 bytes) */
-        for (int j = 0; j < 256; j++) {
-            *buf++ = port_word_in(ATA_PRIMARY_DATA);
-        }
-        
-        ata_delay();
+        queue_service();
+        queue_check_timeout();
     }
     
-    return ATA_SUCCESS;
+    irq_restore(flags);
+    report_dma_failures();
+    return req->status;
+}
+
+/*
+ * Read sectors, waiting for the request to complete. Drives with 48-bit
+ * LBA get the EXT commands; others use 28-bit LBA.
+ * 
+ * lba:    Starting sector number (0-indexed)
+ * count:  Number of sectors to read: 1 to ata_max_sectors(), which is
+ *         65536 with 48-bit LBA and 256 without
+ * buffer: Destination buffer (must be at least count * 512 bytes)
+ * 
+ * Returns: ATA_SUCCESS or error code
+ */
+int ata_read_sectors(uint32_t lba, uint32_t count, void* buffer) {
+    return ata_transfer(lba, count, buffer, false);
 }
 
 /*
@@ -131,33 +757,239 @@ int ata_read_sectors(uint32_t lba, uint8_t count, void* buffer) {
  * size:   Number of bytes to read
  * buffer: Destination buffer
  * 
+ * Only a partial first or last sector goes through a bounce buffer;
+ * whole sectors are read straight into buffer, up to ata_max_sectors()
+ * per command.
+ * 
  * Returns: Number of bytes read, or negative error code
  */
 int ata_read_bytes(uint32_t offset, uint32_t size, void* buffer) {
     uint8_t sector_buffer[ATA_SECTOR_SIZE];
     uint8_t* dest = (uint8_t*)buffer;
-    uint32_t bytes_read = 0;
+    uint32_t lba = offset / ATA_SECTOR_SIZE;
+    uint32_t sector_offset = offset % ATA_SECTOR_SIZE;
+    uint32_t remaining = size;
+    int result;
     
-    while (size > 0) {
-        uint32_t lba = offset / ATA_SECTOR_SIZE;
-        uint32_t sector_offset = offset % ATA_SECTOR_SIZE;
-        uint32_t bytes_in_sector = ATA_SECTOR_SIZE - sector_offset;
-        uint32_t to_copy = (size < bytes_in_sector) ? size : bytes_in_sector;
+    /* Head: the rest of a sector we start part way into */
+    if (sector_offset != 0 && remaining > 0) {
+        uint32_t to_copy = ATA_SECTOR_SIZE - sector_offset;
+        if (to_copy > remaining) to_copy = remaining;
         
-        /* Read the sector */
-        int result = ata_read_sectors(lba, 1, sector_buffer);
+        result = ata_read_sectors(lba, 1, sector_buffer);
         if (result != ATA_SUCCESS) {
             return result;
         }
-        
-        /* Copy the relevant bytes */
         memcpy(dest, sector_buffer + sector_offset, to_copy);
         
         dest += to_copy;
-        offset += to_copy;
-        size -= to_copy;
-        bytes_read += to_copy;
+        remaining -= to_copy;
+        lba++;
+    }
+    
+    /* Middle: whole sectors, directly into the destination */
+    while (remaining >= ATA_SECTOR_SIZE) {
+        uint32_t sectors = remaining / ATA_SECTOR_SIZE;
+        if (sectors > ata_max_sectors()) sectors = ata_max_sectors();
+        
+        result = ata_read_sectors(lba, sectors, dest);
+        if (result != ATA_SUCCESS) {
+            return result;
+        }
+        
+        dest += sectors * ATA_SECTOR_SIZE;
+        remaining -= sectors * ATA_SECTOR_SIZE;
+        lba += sectors;
+    }
+    
+    /* Tail: the start of one more sector */
+    if (remaining > 0) {
+        result = ata_read_sectors(lba, 1, sector_buffer);
+        if (result != ATA_SUCCESS) {
+            return result;
+        }
+        memcpy(dest, sector_buffer, remaining);
+    }
+    
+    return size;
+}
+
+/*
+ * Write sectors, waiting for the request to complete. Drives with 48-bit
+ * LBA get the EXT commands; others use 28-bit LBA.
+ * 
+ * lba:    Starting sector number (0-indexed)
+ * count:  Number of sectors to write: 1 to ata_max_sectors(), which is
+ *         65536 with 48-bit LBA and 256 without
+ * buffer: Source buffer (count * 512 bytes)
+ * 
+ * The data may sit in the drive's write cache until ata_flush().
+ * 
+ * Returns: ATA_SUCCESS or error code
+ */
+int ata_write_sectors(uint32_t lba, uint32_t count, const void* buffer) {
+    return ata_transfer(lba, count, (void*)buffer, true);
+}
+
+/*
+ * Write arbitrary bytes to disk
+ * 
+ * offset: Byte offset from start of disk
+ * size:   Number of bytes to write
+ * buffer: Source buffer
+ * 
+ * Partial first and last sectors are read, patched and written back;
+ * whole sectors go out straight from buffer, up to ata_max_sectors() per
+ * command. Nothing is flushed: call ata_flush() at a sync point.
+ * 
+ * Returns: Number of bytes written, or negative error code
+ */
+int ata_write_bytes(uint32_t offset, uint32_t size, const void* buffer) {
+    uint8_t sector_buffer[ATA_SECTOR_SIZE];
+    const uint8_t* src = (const uint8_t*)buffer;
+    uint32_t lba = offset / ATA_SECTOR_SIZE;
+    uint32_t sector_offset = offset % ATA_SECTOR_SIZE;
+    uint32_t remaining = size;
+    int result;
+    
+    /* Head: patch the end of a sector we start part way into */
+    if (sector_offset != 0 && remaining > 0) {
+        uint32_t to_copy = ATA_SECTOR_SIZE - sector_offset;
+        if (to_copy > remaining) to_copy = remaining;
+        
+        result = ata_read_sectors(lba, 1, sector_buffer);
+        if (result != ATA_SUCCESS) {
+            return result;
+        }
+        memcpy(sector_buffer + sector_offset, src, to_copy);
+        result = ata_write_sectors(lba, 1, sector_buffer);
+        if (result != ATA_SUCCESS) {
+            return result;
+        }
+        
+        src += to_copy;
+        remaining -= to_copy;
+        lba++;
+    }
+    
+    /* Middle: whole sectors, coalesced into as few commands as possible */
+    while (remaining >= ATA_SECTOR_SIZE) {
+        uint32_t sectors = remaining / ATA_SECTOR_SIZE;
+        if (sectors > ata_max_sectors()) sectors = ata_max_sectors();
+        
+        result = ata_write_sectors(lba, sectors, src);
+        if (result != ATA_SUCCESS) {
+            return result;
+        }
+        
+        src += sectors * ATA_SECTOR_SIZE;
+        remaining -= sectors * ATA_SECTOR_SIZE;
+        lba += sectors;
+    }
+    
+    /* Tail: patch the start of one more sector */
+    if (remaining > 0) {
+        result = ata_read_sectors(lba, 1, sector_buffer);
+        if (result != ATA_SUCCESS) {
+            return result;
+        }
+        memcpy(sector_buffer, src, remaining);
+        result = ata_write_sectors(lba, 1, sector_buffer);
+        if (result != ATA_SUCCESS) {
+            return result;
+        }
+    }
+    
+    return size;
+}
+
+/* Commit the drive's write cache to the medium */
+int ata_flush(void) {
+    if (!drive.present) {
+        return ATA_ERR_NO_DRIVE;
+    }
+    queue_drain();
+    if (ata_wait_bsy() != ATA_SUCCESS) {
+        return ATA_ERR_TIMEOUT;
+    }
+    port_byte_out(ATA_PRIMARY_DRIVE_HEAD, 0xE0);
+    ata_delay();
+    port_byte_out(ATA_PRIMARY_COMMAND, drive.lba48 ? ATA_CMD_FLUSH_CACHE_EXT : ATA_CMD_FLUSH_CACHE);
+    return ata_wait_done(ATA_ERR_WRITE);
+}
+
+/* Read BENCH_SECTORS as back-to-back queued requests of 256 sectors */
+static int bench_queued(uint8_t* buffer) {
+    AtaRequest requests[BENCH_SECTORS / ATA_MAX_SECTORS];
+    int result = ATA_SUCCESS;
+    
+    for (int i = 0; i < BENCH_SECTORS / ATA_MAX_SECTORS; i++) {
+        requests[i].lba = i * ATA_MAX_SECTORS;
+        requests[i].count = ATA_MAX_SECTORS;
+        requests[i].write = false;
+        requests[i].buffer = buffer + i * ATA_MAX_SECTORS * ATA_SECTOR_SIZE;
+        requests[i].callback = NULL;
+        ata_submit(&requests[i]);
+    }
+    for (int i = 0; i < BENCH_SECTORS / ATA_MAX_SECTORS; i++) {
+        if (ata_wait(&requests[i]) != ATA_SUCCESS) result = ATA_ERR_READ;
+    }
+    return result;
+}
+
+/* Read BENCH_SECTORS with one transfer method; returns microseconds */
+static uint32_t bench_read(int mode, bool dma, bool queued, uint8_t* buffer, uint64_t* cycles) {
+    int saved = pio_mode;
+    bool saved_dma = dma_enabled;
+    pio_mode = mode;
+    dma_enabled = dma;
+    
+    uint64_t start_cycles = time_cycles();
+    uint64_t start = time_ns();
+    int result = queued ? bench_queued(buffer)
+                        : ata_read_bytes(0, BENCH_SECTORS * ATA_SECTOR_SIZE, buffer);
+    uint64_t elapsed = time_ns() - start;
+    *cycles = time_cycles() - start_cycles;
+    
+    pio_mode = saved;
+    dma_enabled = saved_dma && (!dma || dma_enabled);   /* Unless DMA just failed */
+    if (result < 0) return 0;
+    return (uint32_t)udiv64(elapsed, 1000, NULL);
+}
+
+/* Compare sector throughput of the PIO data-phase methods and DMA */
+void ata_benchmark(void) {
+    static const char* names[] = { "port_word_in loop", "rep insw", "rep insd",
+                                   "bus-master DMA", "queued requests" };
+    bool has_dma = dma_enabled;
+    
+    uint8_t* buffer = (uint8_t*)malloc(BENCH_SECTORS * ATA_SECTOR_SIZE);
+    if (!buffer) {
+        screen_print_color("Benchmark: out of memory\n", ERROR_COLOR);
+        return;
+    }
+    
+    screen_print_color("\n=== ATA Benchmark ===\n", INFO_COLOR);
+    kprintf("Reading %u KB from LBA 0, %u sectors per command\n",
+            BENCH_SECTORS * ATA_SECTOR_SIZE / 1024, ata_max_sectors());
+    kprintf("%-20s%12s%18s\n", "Transfer", "KB/s", "Cycles/sector");
+    
+    for (int mode = PIO_WORD_LOOP; mode <= BENCH_QUEUED; mode++) {
+        bool dma = mode == BENCH_DMA || (mode == BENCH_QUEUED && has_dma);
+        if (mode == BENCH_DMA && !has_dma) continue;
+        
+        /* The last rows keep the default PIO mode as their fallback */
+        uint64_t cycles;
+        uint32_t us = bench_read(mode >= BENCH_DMA ? pio_mode : mode, dma,
+                                 mode == BENCH_QUEUED, buffer, &cycles);
+        if (us == 0) {
+            kprintf("%-20s%12s\n", names[mode], "failed");
+            continue;
+        }
+        uint32_t kb_per_s = (uint32_t)udiv64((uint64_t)BENCH_SECTORS * ATA_SECTOR_SIZE / 1024 * 1000000, us, NULL);
+        uint32_t per_sector = (uint32_t)udiv64(cycles, BENCH_SECTORS, NULL);
+        kprintf("%-20s%12u%18u\n", names[mode], kb_per_s, per_sector);
     }
     
-    return bytes_read;
+    free(buffer);
 }
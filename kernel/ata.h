@@ -2,7 +2,9 @@
  * ============================================================================
  * ATA Disk Driver Header
  * ============================================================================
- * ATA PIO mode driver for reading sectors from disk
+ * ATA driver for reading and writing sectors, by bus-master DMA when
+ * the IDE controller supports it and by PIO otherwise, through an
+ * interrupt-driven request queue
  * Used to load LLM model weights
  * ============================================================================
  */
@@ -22,11 +24,42 @@
 #define ATA_PRIMARY_DRIVE_HEAD   0x1F6
 #define ATA_PRIMARY_STATUS       0x1F7
 #define ATA_PRIMARY_COMMAND      0x1F7
+#define ATA_PRIMARY_CONTROL      0x3F6
+#define ATA_PRIMARY_ALT_STATUS   0x3F6   /* Status without acknowledging */
+
+/* Device control register bits */
+#define ATA_CONTROL_NIEN         0x02    /* Mask the drive's interrupt */
+#define ATA_CONTROL_SRST         0x04    /* Software reset */
+
+/* Bus-master IDE registers (offsets from the controller's BAR4) */
+#define ATA_BM_COMMAND           0x00
+#define ATA_BM_STATUS            0x02
+#define ATA_BM_PRDT              0x04    /* Physical address of the PRD table */
+
+#define ATA_BM_CMD_START         0x01
+#define ATA_BM_CMD_READ          0x08    /* Direction: drive to memory */
+
+#define ATA_BM_STATUS_ACTIVE     0x01
+#define ATA_BM_STATUS_ERROR      0x02    /* Write 1 to clear */
+#define ATA_BM_STATUS_IRQ        0x04    /* Write 1 to clear */
 
 /* ATA Commands */
-#define ATA_CMD_READ_SECTORS     0x20
-#define ATA_CMD_WRITE_SECTORS    0x30
-#define ATA_CMD_IDENTIFY         0xEC
+#define ATA_CMD_READ_SECTORS       0x20
+#define ATA_CMD_READ_SECTORS_EXT   0x24
+#define ATA_CMD_READ_DMA_EXT       0x25
+#define ATA_CMD_READ_MULTIPLE_EXT  0x29
+#define ATA_CMD_WRITE_SECTORS      0x30
+#define ATA_CMD_WRITE_SECTORS_EXT  0x34
+#define ATA_CMD_WRITE_DMA_EXT      0x35
+#define ATA_CMD_WRITE_MULTIPLE_EXT 0x39
+#define ATA_CMD_READ_MULTIPLE      0xC4
+#define ATA_CMD_WRITE_MULTIPLE     0xC5
+#define ATA_CMD_SET_MULTIPLE       0xC6
+#define ATA_CMD_READ_DMA           0xC8
+#define ATA_CMD_WRITE_DMA          0xCA
+#define ATA_CMD_FLUSH_CACHE        0xE7
+#define ATA_CMD_FLUSH_CACHE_EXT    0xEA
+#define ATA_CMD_IDENTIFY           0xEC
 
 /* ATA Status bits */
 #define ATA_STATUS_BSY           0x80    /* Busy */
@@ -37,15 +70,67 @@
 /* Sector size */
 #define ATA_SECTOR_SIZE          512
 
+/* Most sectors one command transfers (sent as a count of 0) */
+#define ATA_MAX_SECTORS          256     /* 28-bit LBA */
+#define ATA_MAX_SECTORS_EXT      65536   /* 48-bit LBA */
+
+/* What IDENTIFY DEVICE told us about the primary master */
+typedef struct {
+    bool present;
+    char model[41];
+    char serial[21];
+    char firmware[9];
+    uint32_t sectors;           /* Addressable sectors (capped at 2^32) */
+    bool lba48;                 /* 48-bit commands supported */
+    bool dma;                   /* Drive supports DMA */
+    uint16_t cylinders;         /* Legacy CHS geometry */
+    uint16_t heads;
+    uint16_t sectors_per_track;
+    uint8_t max_multiple;       /* Largest READ/WRITE MULTIPLE block */
+    uint8_t multiple;           /* Block size in use, 0 if not enabled */
+} AtaDriveInfo;
+
+/*
+ * An asynchronous transfer for ata_submit(). Fill in lba, count, write,
+ * buffer and optionally callback/context; the driver owns the rest.
+ * The callback follows the IrqHandler rules: no floats, but memcpy and
+ * friends are safe (they avoid SSE in interrupt context).
+ */
+typedef struct AtaRequest {
+    uint32_t lba;
+    uint32_t count;                             /* 1 to ata_max_sectors() */
+    bool write;
+    void* buffer;
+    void (*callback)(struct AtaRequest* req);   /* Called in IRQ context,
+                                                   not for rejected requests */
+    void* context;                              /* For the callback */
+    volatile int status;                        /* ATA_PENDING, then result */
+    struct AtaRequest* next;                    /* Queue link */
+} AtaRequest;
+
 /* Functions */
 void ata_init(void);
-int  ata_read_sectors(uint32_t lba, uint8_t count, void* buffer);
+int ata_submit(AtaRequest* req);
+bool ata_poll(AtaRequest* req);
+int  ata_wait(AtaRequest* req);
+int  ata_read_sectors(uint32_t lba, uint32_t count, void* buffer);
 int  ata_read_bytes(uint32_t offset, uint32_t size, void* buffer);
+int  ata_write_sectors(uint32_t lba, uint32_t count, const void* buffer);
+int  ata_write_bytes(uint32_t offset, uint32_t size, const void* buffer);
+int  ata_flush(void);
+uint32_t ata_max_sectors(void);
+bool ata_dma_enabled(void);
+const AtaDriveInfo* ata_get_info(void);
+void ata_dump(void);
+void ata_benchmark(void);
 
 /* Error codes */
 #define ATA_SUCCESS              0
+#define ATA_PENDING              1       /* Request still queued or running */
 #define ATA_ERR_TIMEOUT         -1
 #define ATA_ERR_READ            -2
 #define ATA_ERR_NO_DRIVE        -3
+#define ATA_ERR_WRITE           -4
+#define ATA_ERR_RANGE           -5       /* Bad count or LBA for the drive */
 
 #endif /* ATA_H */
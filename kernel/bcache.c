@@ -0,0 +1,303 @@
+/*
+ * ============================================================================
+ * Block Cache Implementation
+ * ============================================================================
+ * A fixed pool of sector buffers (BCACHE_SIZE bytes of data) over
+ * ata_read_sectors(). Buffers are found through a hash table keyed by
+ * LBA and kept on an LRU list; a miss reuses the least recently used
+ * buffer that nobody has pinned.
+ *
+ * bcache_get() returns a pinned buffer that stays valid until
+ * bcache_release(). bcache_read_bytes() is the cached ata_read_bytes():
+ * sectors it finds are copied from RAM, short runs of missing sectors
+ * are loaded into the cache, and long runs (BCACHE_STREAM_SECTORS or
+ * more) are read straight into the destination so one big read does not
+ * flush everything else out.
+ *
+ * Writes go through bcache_write_bytes(), which writes to the disk and
+ * updates any cached copy. Code that writes with ata_write_*() directly
+ * must call bcache_invalidate().
+ * ============================================================================
+ */
+
+#include "bcache.h"
+#include "ata.h"
+#include "memory.h"
+#include "printf.h"
+#include "screen.h"
+
+#define NUM_BUFFERS (BCACHE_SIZE / ATA_SECTOR_SIZE)
+#define HASH_MASK   (BCACHE_HASH_SIZE - 1)
+
+static BlockBuffer buffers[NUM_BUFFERS];
+static BlockBuffer* hash_table[BCACHE_HASH_SIZE];
+static uint8_t* pool = NULL;
+
+/* LRU list: lru_head is the most recently used buffer */
+static BlockBuffer* lru_head = NULL;
+static BlockBuffer* lru_tail = NULL;
+
+static uint32_t hits;
+static uint32_t misses;
+static uint32_t evictions;
+static uint32_t streamed;
+
+/* ============================================================================
+ * Internal Functions
+ * ============================================================================ */
+
+static uint32_t hash(uint32_t lba) {
+    return ((lba * 2654435761u) >> 24) & HASH_MASK;
+}
+
+static BlockBuffer* lookup(uint32_t lba) {
+    for (BlockBuffer* b = hash_table[hash(lba)]; b; b = b->hash_next) {
+        if (b->lba == lba) return b;
+    }
+    return NULL;
+}
+
+static void hash_insert(BlockBuffer* b) {
+    uint32_t bucket = hash(b->lba);
+    b->hash_next = hash_table[bucket];
+    hash_table[bucket] = b;
+}
+
+static void hash_remove(BlockBuffer* b) {
+    BlockBuffer** link = &hash_table[hash(b->lba)];
+    while (*link && *link != b) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) *link = b->hash_next;
+    b->hash_next = NULL;
+}
+
+static void lru_unlink(BlockBuffer* b) {
+    if (b->lru_prev) b->lru_prev->lru_next = b->lru_next;
+    else lru_head = b->lru_next;
+    if (b->lru_next) b->lru_next->lru_prev = b->lru_prev;
+    else lru_tail = b->lru_prev;
+    b->lru_prev = b->lru_next = NULL;
+}
+
+static void lru_push_front(BlockBuffer* b) {
+    b->lru_prev = NULL;
+    b->lru_next = lru_head;
+    if (lru_head) lru_head->lru_prev = b;
+    lru_head = b;
+    if (!lru_tail) lru_tail = b;
+}
+
+static void lru_push_back(BlockBuffer* b) {
+    b->lru_next = NULL;
+    b->lru_prev = lru_tail;
+    if (lru_tail) lru_tail->lru_next = b;
+    lru_tail = b;
+    if (!lru_head) lru_head = b;
+}
+
+/* Least recently used buffer nobody holds, or NULL if all are pinned */
+static BlockBuffer* find_victim(void) {
+    for (BlockBuffer* b = lru_tail; b; b = b->lru_prev) {
+        if (b->pins == 0) return b;
+    }
+    return NULL;
+}
+
+/* Drop a buffer's contents and make it the first to be reused */
+static void discard(BlockBuffer* b) {
+    if (b->valid) hash_remove(b);
+    b->valid = false;
+    lru_unlink(b);
+    lru_push_back(b);
+}
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================ */
+
+/* Allocate the buffer pool (needs the heap) */
+bool bcache_init(void) {
+    pool = (uint8_t*)malloc(BCACHE_SIZE);
+    if (!pool) return false;
+
+    for (int i = 0; i < BCACHE_HASH_SIZE; i++) {
+        hash_table[i] = NULL;
+    }
+    lru_head = lru_tail = NULL;
+    for (int i = 0; i < NUM_BUFFERS; i++) {
+        BlockBuffer* b = &buffers[i];
+        b->lba = 0;
+        b->data = pool + i * ATA_SECTOR_SIZE;
+        b->pins = 0;
+        b->valid = false;
+        b->hash_next = NULL;
+        lru_push_back(b);
+    }
+
+    hits = misses = evictions = streamed = 0;
+    return true;
+}
+
+/*
+ * Get sector lba, reading it on a miss. The buffer is pinned until
+ * bcache_release(). Returns NULL on a read error or if every buffer is
+ * pinned.
+ */
+BlockBuffer* bcache_get(uint32_t lba) {
+    if (!pool) return NULL;
+
+    BlockBuffer* b = lookup(lba);
+    if (b) {
+        hits++;
+    } else {
+        b = find_victim();
+        if (!b) return NULL;
+
+        misses++;
+        if (b->valid) evictions++;
+        discard(b);
+        if (ata_read_sectors(lba, 1, b->data) != ATA_SUCCESS) {
+            return NULL;
+        }
+        b->lba = lba;
+        b->valid = true;
+        hash_insert(b);
+    }
+
+    b->pins++;
+    lru_unlink(b);
+    lru_push_front(b);
+    return b;
+}
+
+void bcache_release(BlockBuffer* buffer) {
+    if (buffer && buffer->pins > 0) {
+        buffer->pins--;
+    }
+}
+
+/*
+ * Cached version of ata_read_bytes()
+ * Returns: Number of bytes read, or negative error code
+ */
+int bcache_read_bytes(uint32_t offset, uint32_t size, void* buffer) {
+    uint8_t* dest = (uint8_t*)buffer;
+    uint32_t lba = offset / ATA_SECTOR_SIZE;
+    uint32_t skip = offset % ATA_SECTOR_SIZE;
+    uint32_t remaining = size;
+
+    if (!pool) return ata_read_bytes(offset, size, buffer);
+
+    while (remaining > 0) {
+        uint32_t chunk = ATA_SECTOR_SIZE - skip;
+        if (chunk > remaining) chunk = remaining;
+
+        /* A long run of whole, uncached sectors goes around the cache */
+        if (chunk == ATA_SECTOR_SIZE && !lookup(lba)) {
+            uint32_t run = 1;
+            while (run < remaining / ATA_SECTOR_SIZE && run < ata_max_sectors() &&
+                   !lookup(lba + run)) {
+                run++;
+            }
+            if (run >= BCACHE_STREAM_SECTORS) {
+                int result = ata_read_sectors(lba, run, dest);
+                if (result != ATA_SUCCESS) return result;
+                streamed += run;
+                dest += run * ATA_SECTOR_SIZE;
+                remaining -= run * ATA_SECTOR_SIZE;
+                lba += run;
+                continue;
+            }
+        }
+
+        BlockBuffer* b = bcache_get(lba);
+        if (!b) return ATA_ERR_READ;
+        memcpy(dest, b->data + skip, chunk);
+        bcache_release(b);
+
+        dest += chunk;
+        remaining -= chunk;
+        lba++;
+        skip = 0;
+    }
+
+    return size;
+}
+
+/*
+ * Write through to the disk, keeping cached copies current
+ * Returns: Number of bytes written, or negative error code
+ */
+int bcache_write_bytes(uint32_t offset, uint32_t size, const void* buffer) {
+    int result = ata_write_bytes(offset, size, buffer);
+
+    if (pool && size > 0) {
+        const uint8_t* src = (const uint8_t*)buffer;
+        uint32_t first = offset / ATA_SECTOR_SIZE;
+        uint32_t last = (offset + size - 1) / ATA_SECTOR_SIZE;
+
+        for (uint32_t lba = first; lba <= last; lba++) {
+            BlockBuffer* b = lookup(lba);
+            if (!b) continue;
+
+            /* After a failed write the disk contents are unknown */
+            if (result < 0) {
+                if (b->pins == 0) discard(b);
+                continue;
+            }
+
+            uint32_t start = lba * ATA_SECTOR_SIZE;
+            uint32_t from = start > offset ? start : offset;
+            uint32_t to = start + ATA_SECTOR_SIZE < offset + size ? start + ATA_SECTOR_SIZE
+                                                                 : offset + size;
+            memcpy(b->data + (from - start), src + (from - offset), to - from);
+        }
+    }
+
+    return result;
+}
+
+/* Forget every unpinned buffer (after writing around the cache) */
+void bcache_invalidate(void) {
+    for (int i = 0; i < NUM_BUFFERS; i++) {
+        if (buffers[i].valid && buffers[i].pins == 0) {
+            discard(&buffers[i]);
+        }
+    }
+}
+
+void bcache_get_stats(BcacheStats* stats) {
+    stats->buffers = pool ? NUM_BUFFERS : 0;
+    stats->cached = 0;
+    stats->pinned = 0;
+    for (int i = 0; pool && i < NUM_BUFFERS; i++) {
+        if (buffers[i].valid) stats->cached++;
+        if (buffers[i].pins) stats->pinned++;
+    }
+    stats->hits = hits;
+    stats->misses = misses;
+    stats->evictions = evictions;
+    stats->streamed = streamed;
+}
+
+/* Print cache occupancy and hit rate */
+void bcache_dump(void) {
+    BcacheStats stats;
+    bcache_get_stats(&stats);
+
+    screen_print_color("\n=== Block Cache ===\n", INFO_COLOR);
+    if (!stats.buffers) {
+        screen_print("Not initialized\n");
+        return;
+    }
+
+    uint32_t lookups = stats.hits + stats.misses;
+    uint32_t rate = lookups ? (uint32_t)udiv64((uint64_t)stats.hits * 1000, lookups, NULL) : 0;
+    kprintf("Buffers:   %u x %u bytes (%u KB), %u cached, %u pinned\n",
+            stats.buffers, ATA_SECTOR_SIZE, BCACHE_SIZE / 1024, stats.cached, stats.pinned);
+    kprintf("Hits:      %u\n", stats.hits);
+    kprintf("Misses:    %u (hit rate %u.%u%%)\n", stats.misses, rate / 10, rate % 10);
+    kprintf("Evictions: %u\n", stats.evictions);
+    kprintf("Streamed:  %u sectors read around the cache\n", stats.streamed);
+}
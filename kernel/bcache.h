@@ -0,0 +1,55 @@
+/*
+ * ============================================================================
+ * Block Cache Header
+ * ============================================================================
+ * Cache of disk sectors between the ATA driver and its callers
+ * ============================================================================
+ */
+
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include "kernel.h"
+
+/* Memory budget for cached sector data */
+#define BCACHE_SIZE          (256 * 1024)
+
+/* Hash buckets (a power of two) */
+#define BCACHE_HASH_SIZE     256
+
+/* Runs of this many uncached sectors skip the cache (streaming reads) */
+#define BCACHE_STREAM_SECTORS 16
+
+/* One cached sector */
+typedef struct BlockBuffer {
+    uint32_t lba;
+    uint8_t* data;                      /* ATA_SECTOR_SIZE bytes */
+    uint32_t pins;                      /* Users holding it; never evicted while > 0 */
+    bool valid;                         /* data holds sector lba */
+    struct BlockBuffer* hash_next;      /* Next buffer in the same bucket */
+    struct BlockBuffer* lru_prev;       /* Toward the most recently used */
+    struct BlockBuffer* lru_next;       /* Toward the least recently used */
+} BlockBuffer;
+
+/* Statistics */
+typedef struct {
+    uint32_t buffers;
+    uint32_t cached;        /* Buffers holding a sector */
+    uint32_t pinned;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+    uint32_t streamed;      /* Sectors read around the cache */
+} BcacheStats;
+
+/* Block cache functions */
+bool bcache_init(void);
+BlockBuffer* bcache_get(uint32_t lba);
+void bcache_release(BlockBuffer* buffer);
+int bcache_read_bytes(uint32_t offset, uint32_t size, void* buffer);
+int bcache_write_bytes(uint32_t offset, uint32_t size, const void* buffer);
+void bcache_invalidate(void);
+void bcache_get_stats(BcacheStats* stats);
+void bcache_dump(void);
+
+#endif /* BCACHE_H */
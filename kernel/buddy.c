@@ -0,0 +1,290 @@
+/*
+ * ============================================================================
+ * Buddy Page Allocator Implementation
+ * ============================================================================
+ * Manages the usable RAM from the memory map as 4 KB page frames.
+ *
+ * - Blocks are 2^order pages (order 0 = 4 KB ... BUDDY_MAX_ORDER = 4 MB),
+ *   naturally aligned, kept on one free list per order.
+ * - Freeing a block merges it with its buddy while the buddy is free.
+ * - buddy_alloc_pages() hands out an exact page count: it takes the next
+ *   power of two (or a run of 4 MB blocks) and frees the unused tail.
+ * - One byte of state per page (free-block head + order) lives in a table
+ *   carved from the start of the first region big enough to hold it.
+ * ============================================================================
+ */
+
+#include "buddy.h"
+#include "memmap.h"
+#include "printf.h"
+#include "screen.h"
+
+/* page_state[] bits: set on the first page of a free block */
+#define PAGE_FREE 0x80
+#define PAGE_ORDER_MASK 0x0F
+
+#define ORDER_PAGES(order) (1u << (order))
+#define MAX_BLOCK_PAGES ORDER_PAGES(BUDDY_MAX_ORDER)
+
+/* Free lists, one per order */
+static FreePage *free_lists[BUDDY_MAX_ORDER + 1];
+
+/* Per-page state, indexed by physical page number */
+static uint8_t *page_state = NULL;
+static uint32_t num_page_frames = 0; /* Entries in page_state */
+
+/* Managed physical range (may contain holes) */
+static uint32_t managed_lo = 0;
+static uint32_t managed_hi = 0;
+
+static BuddyStats stats;
+
+/* ============================================================================
+ * Internal Functions
+ * ============================================================================
+ */
+
+static uint32_t page_number(void *addr) {
+  return (uint32_t)addr >> PAGE_SHIFT;
+}
+
+static void *page_address(uint32_t pfn) {
+  return (void *)(pfn << PAGE_SHIFT);
+}
+
+/* Push a block onto its free list and mark its head page */
+static void list_push(uint32_t pfn, int order) {
+  FreePage *page = (FreePage *)page_address(pfn);
+
+  page->prev = NULL;
+  page->next = free_lists[order];
+  if (page->next) {
+    page->next->prev = page;
+  }
+  free_lists[order] = page;
+
+  page_state[pfn] = PAGE_FREE | order;
+  stats.free_blocks[order]++;
+  stats.free_pages += ORDER_PAGES(order);
+}
+
+/* Unlink a free block from its list */
+static void list_remove(uint32_t pfn, int order) {
+  FreePage *page = (FreePage *)page_address(pfn);
+
+  if (page->prev) {
+    page->prev->next = page->next;
+  } else {
+    free_lists[order] = page->next;
+  }
+  if (page->next) {
+    page->next->prev = page->prev;
+  }
+
+  page_state[pfn] = 0;
+  stats.free_blocks[order]--;
+  stats.free_pages -= ORDER_PAGES(order);
+}
+
+/* Free one naturally aligned block, merging with free buddies */
+static void free_block(uint32_t pfn, int order) {
+  while (order < BUDDY_MAX_ORDER) {
+    uint32_t buddy = pfn ^ ORDER_PAGES(order);
+    if (buddy >= num_page_frames || page_state[buddy] != (PAGE_FREE | order))
+      break;
+
+    list_remove(buddy, order);
+    pfn &= ~ORDER_PAGES(order);
+    order++;
+  }
+
+  list_push(pfn, order);
+}
+
+/* Free count pages at pfn as the largest aligned blocks that fit */
+static void free_range(uint32_t pfn, uint32_t count) {
+  while (count > 0) {
+    int order = 0;
+    while (order < BUDDY_MAX_ORDER && !(pfn & ORDER_PAGES(order)) &&
+           ORDER_PAGES(order + 1) <= count) {
+      order++;
+    }
+
+    free_block(pfn, order);
+    pfn += ORDER_PAGES(order);
+    count -= ORDER_PAGES(order);
+  }
+}
+
+/* Take `blocks` contiguous free max-order blocks; returns pfn or 0 */
+static uint32_t alloc_max_run(uint32_t blocks) {
+  uint32_t run_start = 0;
+  uint32_t run_len = 0;
+
+  for (uint32_t pfn = managed_lo >> PAGE_SHIFT;
+       pfn + MAX_BLOCK_PAGES <= num_page_frames; pfn += MAX_BLOCK_PAGES) {
+    pfn &= ~(MAX_BLOCK_PAGES - 1);
+    if (page_state[pfn] != (PAGE_FREE | BUDDY_MAX_ORDER)) {
+      run_len = 0;
+      continue;
+    }
+
+    if (run_len == 0) {
+      run_start = pfn;
+    }
+    if (++run_len == blocks) {
+      for (uint32_t i = 0; i < blocks; i++) {
+        list_remove(run_start + i * MAX_BLOCK_PAGES, BUDDY_MAX_ORDER);
+      }
+      return run_start;
+    }
+  }
+
+  return 0;
+}
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================
+ */
+
+/* Hand every usable region from the memory map to the allocator */
+void buddy_init(void) {
+  const MemRegion *regions;
+  int count = memmap_get_regions(&regions);
+
+  memset(free_lists, 0, sizeof(free_lists));
+  memset(&stats, 0, sizeof(stats));
+  if (count == 0)
+    return;
+
+  managed_lo = regions[0].base;
+  managed_hi = regions[count - 1].base + regions[count - 1].size;
+  num_page_frames = managed_hi >> PAGE_SHIFT;
+
+  /* Carve the page state table from the first region that holds it */
+  uint32_t table_bytes =
+      (num_page_frames + PAGE_SIZE - 1) & ~(uint32_t)(PAGE_SIZE - 1);
+  int table_region = -1;
+  for (int i = 0; i < count; i++) {
+    if (regions[i].size > table_bytes) {
+      table_region = i;
+      break;
+    }
+  }
+  if (table_region < 0)
+    return;
+
+  page_state = (uint8_t *)regions[table_region].base;
+  memset(page_state, 0, num_page_frames);
+
+  for (int i = 0; i < count; i++) {
+    uint32_t base = regions[i].base;
+    uint32_t size = regions[i].size;
+    if (i == table_region) {
+      base += table_bytes;
+      size -= table_bytes;
+    }
+
+    stats.total_pages += size >> PAGE_SHIFT;
+    free_range(base >> PAGE_SHIFT, size >> PAGE_SHIFT);
+  }
+}
+
+/* Allocate one block of 2^order pages */
+void *buddy_alloc(int order) {
+  if (order < 0 || order > BUDDY_MAX_ORDER)
+    return NULL;
+
+  /* Smallest non-empty list that fits */
+  int found = order;
+  while (found <= BUDDY_MAX_ORDER && !free_lists[found]) {
+    found++;
+  }
+  if (found > BUDDY_MAX_ORDER)
+    return NULL;
+
+  uint32_t pfn = page_number(free_lists[found]);
+  list_remove(pfn, found);
+
+  /* Split, returning upper halves to the lower lists */
+  while (found > order) {
+    found--;
+    list_push(pfn + ORDER_PAGES(found), found);
+  }
+
+  return page_address(pfn);
+}
+
+/* Free a block obtained from buddy_alloc() */
+void buddy_free(void *addr, int order) {
+  if (!addr || order < 0 || order > BUDDY_MAX_ORDER)
+    return;
+
+  free_block(page_number(addr), order);
+}
+
+/* Allocate exactly count contiguous pages */
+void *buddy_alloc_pages(uint32_t count) {
+  if (count == 0)
+    return NULL;
+
+  uint32_t pfn;
+  uint32_t got;
+
+  if (count > MAX_BLOCK_PAGES) {
+    /* Bigger than one block: find a run of adjacent 4 MB blocks */
+    uint32_t blocks = (count + MAX_BLOCK_PAGES - 1) / MAX_BLOCK_PAGES;
+    pfn = alloc_max_run(blocks);
+    if (!pfn)
+      return NULL;
+    got = blocks * MAX_BLOCK_PAGES;
+  } else {
+    int order = 0;
+    while (ORDER_PAGES(order) < count) {
+      order++;
+    }
+    void *block = buddy_alloc(order);
+    if (!block)
+      return NULL;
+    pfn = page_number(block);
+    got = ORDER_PAGES(order);
+  }
+
+  /* Give back the pages past the requested count */
+  free_range(pfn + count, got - count);
+
+  return page_address(pfn);
+}
+
+/* Free pages obtained from buddy_alloc_pages() */
+void buddy_free_pages(void *addr, uint32_t count) {
+  if (!addr)
+    return;
+
+  free_range(page_number(addr), count);
+}
+
+/* Is this address inside the managed physical range? */
+bool buddy_contains(void *addr) {
+  return (uint32_t)addr >= managed_lo && (uint32_t)addr < managed_hi;
+}
+
+/* Snapshot of the page statistics */
+void buddy_get_stats(BuddyStats *out) {
+  *out = stats;
+}
+
+/* Print page counts */
+void buddy_dump(void) {
+  screen_print_color("=== Physical Pages ===\n", INFO_COLOR);
+
+  kprintf("Pages: %u free of %u (%u of %u MB)\n", stats.free_pages,
+          stats.total_pages, stats.free_pages / 256, stats.total_pages / 256);
+
+  screen_print("Free blocks by order:");
+  for (int order = 0; order <= BUDDY_MAX_ORDER; order++) {
+    kprintf(" %u", stats.free_blocks[order]);
+  }
+  screen_print("\n\n");
+}
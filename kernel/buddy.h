@@ -0,0 +1,44 @@
+/*
+ * ============================================================================
+ * Buddy Page Allocator Header
+ * ============================================================================
+ * Physical page frame allocator (4 KB pages, blocks of 4 KB to 4 MB)
+ * ============================================================================
+ */
+
+#ifndef BUDDY_H
+#define BUDDY_H
+
+#include "kernel.h"
+
+/* Page configuration */
+#define PAGE_SIZE 4096
+#define PAGE_SHIFT 12
+#define BUDDY_MAX_ORDER 10 /* Largest block: PAGE_SIZE << 10 = 4 MB */
+
+/* Links kept at the start of every free block */
+typedef struct FreePage {
+  struct FreePage *next;
+  struct FreePage *prev;
+} FreePage;
+
+/* Page allocator statistics */
+typedef struct BuddyStats {
+  uint32_t total_pages;                        /* Pages under management */
+  uint32_t free_pages;                         /* Pages currently free */
+  uint32_t free_blocks[BUDDY_MAX_ORDER + 1];   /* Free blocks per order */
+} BuddyStats;
+
+/* Page allocator functions */
+void buddy_init(void);
+void *buddy_alloc(int order);
+void buddy_free(void *addr, int order);
+void *buddy_alloc_pages(uint32_t count);
+void buddy_free_pages(void *addr, uint32_t count);
+bool buddy_contains(void *addr);
+
+/* Debug functions */
+void buddy_get_stats(BuddyStats *out);
+void buddy_dump(void);
+
+#endif /* BUDDY_H */
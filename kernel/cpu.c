@@ -0,0 +1,137 @@
+/*
+ * ============================================================================
+ * CPU Feature Detection Implementation
+ * ============================================================================
+ * kernel_entry.asm runs CPUID and enables the FPU and SSE before C code
+ * starts. cpu_init() decodes what it found and fills kernel_ops with the
+ * best implementation of each hot kernel:
+ *
+ * - generic: rep movsd / word-at-a-time string code, x87 float loops
+ * - sse2:    SSE2 block copies and fills (string.c) and packed-float
+ *            dot products and matmul (simd.c, built with -msse2)
+ * ============================================================================
+ */
+
+#include "cpu.h"
+#include "math.h"
+#include "screen.h"
+#include "printf.h"
+
+/* Left behind by cpu_setup in kernel_entry.asm */
+extern char cpu_vendor[13];
+extern uint32_t cpu_max_leaf;
+extern uint32_t cpu_signature;
+extern uint32_t cpu_features_ecx;
+extern uint32_t cpu_features_edx;
+extern uint32_t cpu_sse_enabled;
+
+/* CPUID leaf 1 bit for each CPU_* feature */
+typedef struct {
+    const char* name;
+    uint32_t feature;
+    bool in_ecx;
+    uint32_t bit;
+    bool needs_sse;   /* Unusable unless SSE was enabled */
+} FeatureBit;
+
+static const FeatureBit feature_bits[] = {
+    { "fpu",    CPU_FPU,   false, 1 << 0,  false },
+    { "tsc",    CPU_TSC,   false, 1 << 4,  false },
+    { "msr",    CPU_MSR,   false, 1 << 5,  false },
+    { "pse",    CPU_PSE,   false, 1 << 3,  false },
+    { "pge",    CPU_PGE,   false, 1 << 13, false },
+    { "pat",    CPU_PAT,   false, 1 << 16, false },
+    { "fxsr",   CPU_FXSR,  false, 1 << 24, false },
+    { "sse",    CPU_SSE,   false, 1 << 25, true  },
+    { "sse2",   CPU_SSE2,  false, 1 << 26, true  },
+    { "sse3",   CPU_SSE3,  true,  1 << 0,  true  },
+    { "ssse3",  CPU_SSSE3, true,  1 << 9,  true  },
+    { "sse4.1", CPU_SSE41, true,  1 << 19, true  },
+    { "sse4.2", CPU_SSE42, true,  1 << 20, true  },
+};
+
+#define NUM_FEATURE_BITS (sizeof(feature_bits) / sizeof(feature_bits[0]))
+
+static CpuInfo info;
+
+/* Generic implementations until cpu_init() knows better */
+KernelOps kernel_ops = {
+    "generic",
+    memcpy_generic,
+    memmove_generic,
+    memset_generic,
+    strlen_generic,
+    vec_dot_generic,
+    matmul_generic,
+};
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================ */
+
+/* Decode the CPUID results and pick implementations */
+void cpu_init(void) {
+    memcpy(info.vendor, cpu_vendor, sizeof(info.vendor));
+    info.vendor[12] = '\0';
+
+    /* Family and model, including the extended fields where they apply */
+    info.stepping = cpu_signature & 0xF;
+    info.model = (cpu_signature >> 4) & 0xF;
+    info.family = (cpu_signature >> 8) & 0xF;
+    if (info.family == 0xF) {
+        info.family += (cpu_signature >> 20) & 0xFF;
+    }
+    if (info.family == 0x6 || info.family >= 0xF) {
+        info.model |= ((cpu_signature >> 16) & 0xF) << 4;
+    }
+
+    info.features = 0;
+    for (uint32_t i = 0; i < NUM_FEATURE_BITS; i++) {
+        const FeatureBit* f = &feature_bits[i];
+        uint32_t reg = f->in_ecx ? cpu_features_ecx : cpu_features_edx;
+        if ((reg & f->bit) && (!f->needs_sse || cpu_sse_enabled)) {
+            info.features |= f->feature;
+        }
+    }
+
+    if (cpu_has(CPU_SSE2)) {
+        kernel_ops.level = "sse2";
+        kernel_ops.memcpy = memcpy_sse2;
+        kernel_ops.memmove = memmove_sse2;
+        kernel_ops.memset = memset_sse2;
+        kernel_ops.strlen = strlen_sse2;
+        kernel_ops.dot = vec_dot_sse;
+        kernel_ops.matmul = matmul_sse;
+    }
+}
+
+/* True if the CPU has all of the given CPU_* features */
+bool cpu_has(uint32_t features) {
+    return (info.features & features) == features;
+}
+
+/* CPUID results */
+const CpuInfo* cpu_get_info(void) {
+    return &info;
+}
+
+/* Print the CPU, its features and the implementations in use */
+void cpu_dump(void) {
+    screen_print_color("\n=== CPU ===\n", INFO_COLOR);
+    if (cpu_max_leaf == 0 && !info.vendor[0]) {
+        screen_print("No CPUID instruction\n");
+    } else {
+        kprintf("Vendor:   %s\n", info.vendor);
+        kprintf("Family:   %u  Model: %u  Stepping: %u\n",
+                info.family, info.model, info.stepping);
+    }
+
+    screen_print("Features:");
+    for (uint32_t i = 0; i < NUM_FEATURE_BITS; i++) {
+        if (info.features & feature_bits[i].feature) {
+            kprintf(" %s", feature_bits[i].name);
+        }
+    }
+    kprintf("\nKernels:  %s (memcpy, memmove, memset, strlen, dot, matmul)\n",
+            kernel_ops.level);
+}
@@ -0,0 +1,62 @@
+/*
+ * ============================================================================
+ * CPU Feature Detection Header
+ * ============================================================================
+ * CPUID features and the table of CPU-specific kernel implementations
+ * ============================================================================
+ */
+
+#ifndef CPU_H
+#define CPU_H
+
+#include "kernel.h"
+
+/* Features (SSE ones are only reported once kernel_entry.asm enabled SSE) */
+#define CPU_FPU   (1 << 0)
+#define CPU_TSC   (1 << 1)
+#define CPU_MSR   (1 << 2)
+#define CPU_PSE   (1 << 3)
+#define CPU_PGE   (1 << 4)
+#define CPU_PAT   (1 << 5)
+#define CPU_FXSR  (1 << 6)
+#define CPU_SSE   (1 << 7)
+#define CPU_SSE2  (1 << 8)
+#define CPU_SSE3  (1 << 9)
+#define CPU_SSSE3 (1 << 10)
+#define CPU_SSE41 (1 << 11)
+#define CPU_SSE42 (1 << 12)
+
+/* What CPUID told us */
+typedef struct {
+    char vendor[13];
+    uint32_t family;
+    uint32_t model;
+    uint32_t stepping;
+    uint32_t features;    /* CPU_* flags */
+} CpuInfo;
+
+/*
+ * Hot kernels with more than one implementation. Starts out with the
+ * generic versions, which run on any CPU; cpu_init() swaps in faster
+ * ones the CPU supports. Call through the public wrappers (memcpy(),
+ * vec_dot(), ...) rather than through the table.
+ */
+typedef struct {
+    const char* level;    /* Name of the instruction set selected */
+    void* (*memcpy)(void* dest, const void* src, size_t num);
+    void* (*memmove)(void* dest, const void* src, size_t num);
+    void* (*memset)(void* ptr, int value, size_t num);
+    size_t (*strlen)(const char* str);
+    float (*dot)(const float* a, const float* b, int n);
+    void (*matmul)(float* out, const float* x, const float* w, int n, int d);
+} KernelOps;
+
+extern KernelOps kernel_ops;
+
+/* CPU functions */
+void cpu_init(void);
+bool cpu_has(uint32_t features);
+const CpuInfo* cpu_get_info(void);
+void cpu_dump(void);
+
+#endif /* CPU_H */
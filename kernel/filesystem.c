@@ -9,11 +9,11 @@
  */
 
 #include "filesystem.h"
+#include "timer.h"
 
 /* File storage */
 static FileEntry files[MAX_FILES];
 static uint32_t file_count = 0;
-static uint32_t time_counter = 0;
 
 /* ============================================================================
  * Internal Functions
@@ -47,7 +47,6 @@ static int find_empty_slot(void) {
 void fs_init(void) {
     memset(files, 0, sizeof(files));
     file_count = 0;
-    time_counter = 0;
     
     /* Create a welcome file */
     fs_create("welcome.txt");
@@ -94,7 +93,7 @@ int fs_create(const char* filename) {
     files[slot].data[0] = '\0';
     files[slot].size = 0;
     files[slot].used = true;
-    files[slot].created_time = ++time_counter;
+    files[slot].created_time = time_ms();
     file_count++;
     
     return FS_SUCCESS;
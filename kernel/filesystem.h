@@ -22,7 +22,7 @@ typedef struct {
     char     data[MAX_FILE_SIZE];
     uint32_t size;
     bool     used;
-    uint32_t created_time;
+    uint32_t created_time;   /* Milliseconds since boot */
 } FileEntry;
 
 /* File System Functions */
@@ -0,0 +1,250 @@
+/*
+ * ============================================================================
+ * Interrupt Handling Implementation
+ * ============================================================================
+ * Builds the IDT from the stubs in isr.asm and remaps the two 8259 PICs
+ * so IRQs 0-15 arrive on vectors 32-47 instead of colliding with the CPU
+ * exceptions.
+ *
+ * CPU exceptions print the faulting state and halt. IRQs go to the
+ * handler registered with irq_register() and are then acknowledged. Every
+ * line stays masked until it has a handler.
+ *
+ * Reference: https://wiki.osdev.org/8259_PIC
+ * ============================================================================
+ */
+
+#include "interrupt.h"
+#include "printf.h"
+#include "screen.h"
+
+/* PIC I/O ports */
+#define PIC1_COMMAND 0x20
+#define PIC1_DATA    0x21
+#define PIC2_COMMAND 0xA0
+#define PIC2_DATA    0xA1
+
+/* PIC commands */
+#define PIC_ICW1_INIT_ICW4 0x11     /* Edge triggered, cascaded, ICW4 follows */
+#define PIC_ICW4_8086      0x01
+#define PIC_EOI            0x20
+#define PIC_READ_ISR       0x0B
+
+/* Any write to this unused port takes about a microsecond */
+#define IO_WAIT_PORT 0x80
+
+/* 32-bit interrupt gate, present, ring 0 */
+#define IDT_INTERRUPT_GATE 0x8E
+
+/* Flat code segment set up by the bootloader */
+#define KERNEL_CODE_SEGMENT 0x08
+
+#define EXCEPTION_COUNT 32
+#define PAGE_FAULT 14
+
+typedef struct {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t zero;
+    uint8_t type;
+    uint16_t offset_high;
+} __attribute__((packed)) IdtEntry;
+
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) IdtPointer;
+
+/* From isr.asm */
+extern uint32_t isr_stub_table[EXCEPTION_COUNT + IRQ_COUNT];
+extern void idt_load(const IdtPointer* idtr);
+
+static IdtEntry idt[256];
+static IdtPointer idtr;
+
+static IrqHandler irq_handlers[IRQ_COUNT];
+static uint32_t irq_counts[IRQ_COUNT];
+static uint32_t spurious_count;
+
+/* IRQ handlers running right now (see in_interrupt()) */
+volatile uint32_t irq_depth;
+
+static const char* exception_names[EXCEPTION_COUNT] = {
+    "Divide error", "Debug", "NMI", "Breakpoint",
+    "Overflow", "BOUND range exceeded", "Invalid opcode", "Device not available",
+    "Double fault", "Coprocessor segment overrun", "Invalid TSS", "Segment not present",
+    "Stack fault", "General protection fault", "Page fault", "Reserved",
+    "x87 floating point", "Alignment check", "Machine check", "SIMD floating point",
+    "Virtualization", "Control protection", "Reserved", "Reserved",
+    "Reserved", "Reserved", "Reserved", "Reserved",
+    "Reserved", "VMM communication", "Security", "Reserved",
+};
+
+/* ============================================================================
+ * Internal Functions
+ * ============================================================================ */
+
+static void io_wait(void) {
+    port_byte_out(IO_WAIT_PORT, 0);
+}
+
+static void idt_set_gate(int vector, uint32_t handler) {
+    idt[vector].offset_low = handler & 0xFFFF;
+    idt[vector].selector = KERNEL_CODE_SEGMENT;
+    idt[vector].zero = 0;
+    idt[vector].type = IDT_INTERRUPT_GATE;
+    idt[vector].offset_high = handler >> 16;
+}
+
+/* Move the PICs to vectors 32-47 and mask every line but the cascade */
+static void pic_remap(void) {
+    port_byte_out(PIC1_COMMAND, PIC_ICW1_INIT_ICW4);
+    io_wait();
+    port_byte_out(PIC2_COMMAND, PIC_ICW1_INIT_ICW4);
+    io_wait();
+    port_byte_out(PIC1_DATA, IRQ_BASE);             /* ICW2: vector offsets */
+    io_wait();
+    port_byte_out(PIC2_DATA, IRQ_BASE + 8);
+    io_wait();
+    port_byte_out(PIC1_DATA, 1 << IRQ_CASCADE);     /* ICW3: slave on IRQ 2 */
+    io_wait();
+    port_byte_out(PIC2_DATA, IRQ_CASCADE);
+    io_wait();
+    port_byte_out(PIC1_DATA, PIC_ICW4_8086);
+    io_wait();
+    port_byte_out(PIC2_DATA, PIC_ICW4_8086);
+    io_wait();
+
+    port_byte_out(PIC1_DATA, (uint8_t)~(1 << IRQ_CASCADE));
+    port_byte_out(PIC2_DATA, 0xFF);
+}
+
+/* Acknowledge an IRQ (both PICs if it came through the slave) */
+static void pic_eoi(int irq) {
+    if (irq >= 8) {
+        port_byte_out(PIC2_COMMAND, PIC_EOI);
+    }
+    port_byte_out(PIC1_COMMAND, PIC_EOI);
+}
+
+/*
+ * IRQ 7 and 15 also fire when a request goes away before the CPU takes
+ * it. Such spurious IRQs are not in the PIC's in-service register and
+ * must not be acknowledged (except on the master, for the cascade).
+ */
+static bool pic_spurious(int irq) {
+    if (irq != 7 && irq != 15) return false;
+
+    uint16_t command = irq == 7 ? PIC1_COMMAND : PIC2_COMMAND;
+    port_byte_out(command, PIC_READ_ISR);
+    if (port_byte_in(command) & 0x80) return false;
+
+    if (irq == 15) {
+        port_byte_out(PIC1_COMMAND, PIC_EOI);
+    }
+    return true;
+}
+
+/* Report a CPU exception and stop */
+static void exception(InterruptFrame* frame) {
+    kprintf_color(ERROR_COLOR, "\n*** CPU exception %u: %s (error code 0x%x) ***\n",
+                  frame->vector, exception_names[frame->vector], frame->error_code);
+    if (frame->vector == PAGE_FAULT) {
+        uint32_t cr2;
+        __asm__ volatile("mov %%cr2, %0" : "=r"(cr2));
+        kprintf_color(ERROR_COLOR, "Faulting address: 0x%08x\n", cr2);
+    }
+    kprintf("EIP=%08x CS=%04x EFLAGS=%08x\n", frame->eip, frame->cs, frame->eflags);
+    kprintf("EAX=%08x EBX=%08x ECX=%08x EDX=%08x\n",
+            frame->eax, frame->ebx, frame->ecx, frame->edx);
+    kprintf("ESI=%08x EDI=%08x EBP=%08x ESP=%08x\n",
+            frame->esi, frame->edi, frame->ebp, frame->esp);
+    kprintf_color(ERROR_COLOR, "System halted.\n");
+
+    for (;;) {
+        __asm__ volatile("cli; hlt");
+    }
+}
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================ */
+
+/* Load the IDT and remap the PICs. Interrupts stay disabled. */
+void interrupt_init(void) {
+    memset(idt, 0, sizeof(idt));
+    for (int vector = 0; vector < EXCEPTION_COUNT + IRQ_COUNT; vector++) {
+        idt_set_gate(vector, isr_stub_table[vector]);
+    }
+    idtr.limit = sizeof(idt) - 1;
+    idtr.base = (uint32_t)idt;
+    idt_load(&idtr);
+
+    for (int irq = 0; irq < IRQ_COUNT; irq++) {
+        irq_handlers[irq] = NULL;
+        irq_counts[irq] = 0;
+    }
+    spurious_count = 0;
+
+    pic_remap();
+}
+
+/* Install the handler for an IRQ line and unmask it */
+void irq_register(int irq, IrqHandler handler) {
+    if (irq < 0 || irq >= IRQ_COUNT) return;
+
+    uint32_t flags = irq_save();
+    irq_handlers[irq] = handler;
+    irq_restore(flags);
+    irq_unmask(irq);
+}
+
+void irq_mask(int irq) {
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    port_byte_out(port, port_byte_in(port) | (1 << (irq & 7)));
+}
+
+void irq_unmask(int irq) {
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    port_byte_out(port, port_byte_in(port) & ~(1 << (irq & 7)));
+}
+
+/* Interrupts taken on an IRQ line since boot */
+uint32_t irq_count(int irq) {
+    return (irq >= 0 && irq < IRQ_COUNT) ? irq_counts[irq] : 0;
+}
+
+/* Entry from isr.asm for every vector */
+void interrupt_dispatch(InterruptFrame* frame) {
+    if (frame->vector < EXCEPTION_COUNT) {
+        exception(frame);
+        return;
+    }
+
+    int irq = frame->vector - IRQ_BASE;
+    if (pic_spurious(irq)) {
+        spurious_count++;
+        return;
+    }
+
+    irq_counts[irq]++;
+    if (irq_handlers[irq]) {
+        irq_depth++;
+        irq_handlers[irq](frame);
+        irq_depth--;
+    }
+    pic_eoi(irq);
+}
+
+/* Print the unmasked IRQ lines and how often each fired */
+void interrupt_dump(void) {
+    uint16_t mask = port_byte_in(PIC1_DATA) | (port_byte_in(PIC2_DATA) << 8);
+
+    screen_print_color("\n=== Interrupts ===\n", INFO_COLOR);
+    for (int irq = 0; irq < IRQ_COUNT; irq++) {
+        if (!(mask & (1 << irq)) && irq != IRQ_CASCADE) {
+            kprintf("IRQ %-2d  %u\n", irq, irq_counts[irq]);
+        }
+    }
+    kprintf("Spurious: %u\n", spurious_count);
+}
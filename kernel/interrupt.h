@@ -0,0 +1,92 @@
+/*
+ * ============================================================================
+ * Interrupt Handling Header
+ * ============================================================================
+ * IDT, CPU exceptions and 8259 PIC hardware interrupts
+ * ============================================================================
+ */
+
+#ifndef INTERRUPT_H
+#define INTERRUPT_H
+
+#include "kernel.h"
+
+/* IRQs 0-15 are remapped to vectors 32-47, above the CPU exceptions */
+#define IRQ_BASE         32
+#define IRQ_COUNT        16
+
+/* IRQ lines */
+#define IRQ_TIMER        0
+#define IRQ_KEYBOARD     1
+#define IRQ_CASCADE      2
+#define IRQ_COM1         4
+#define IRQ_PRIMARY_ATA  14
+
+/* EFLAGS interrupt enable bit */
+#define EFLAGS_IF        0x200
+
+/* Stack contents when an interrupt reaches C (see isr.asm) */
+typedef struct {
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;   /* pushad */
+    uint32_t vector;
+    uint32_t error_code;                               /* 0 if none */
+    uint32_t eip, cs, eflags;                          /* Pushed by the CPU */
+} InterruptFrame;
+
+/*
+ * IRQ handlers run with interrupts disabled, before the end-of-interrupt
+ * is sent. They must be short and must not use the FPU or SSE, since
+ * isr.asm does not save that state: no floats. memcpy, memset, memmove
+ * and strlen are fine; they skip their SSE2 paths while in_interrupt().
+ */
+typedef void (*IrqHandler)(InterruptFrame* frame);
+
+/* Functions */
+void interrupt_init(void);
+void irq_register(int irq, IrqHandler handler);
+void irq_mask(int irq);
+void irq_unmask(int irq);
+uint32_t irq_count(int irq);
+void interrupt_dump(void);
+
+/* Called from isr.asm */
+void interrupt_dispatch(InterruptFrame* frame);
+
+extern volatile uint32_t irq_depth;
+
+/* Is an IRQ handler running (so FPU/SSE state must not be touched)? */
+static inline bool in_interrupt(void) {
+    return irq_depth != 0;
+}
+
+static inline void interrupts_enable(void) {
+    __asm__ volatile("sti" ::: "memory");
+}
+
+static inline void interrupts_disable(void) {
+    __asm__ volatile("cli" ::: "memory");
+}
+
+/* Disable interrupts, returning the previous EFLAGS for irq_restore() */
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile("pushfl; popl %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    if (flags & EFLAGS_IF) {
+        __asm__ volatile("sti" ::: "memory");
+    }
+}
+
+/*
+ * Enable interrupts and halt until one arrives. The instruction after
+ * sti runs before any interrupt is taken, so a caller that checked for
+ * work with interrupts disabled cannot miss the wakeup.
+ */
+static inline void wait_for_interrupt(void) {
+    __asm__ volatile("sti; hlt" ::: "memory");
+}
+
+#endif /* INTERRUPT_H */
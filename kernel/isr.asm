@@ -0,0 +1,111 @@
+; ============================================================================
+; Interrupt Entry Stubs
+; ============================================================================
+; One small stub per vector (0-31 CPU exceptions, 32-47 remapped IRQs).
+; Each pushes a dummy error code where the CPU does not push one, then its
+; vector number, so every interrupt reaches interrupt_dispatch() in
+; interrupt.c with the same InterruptFrame layout:
+;
+;   pushad registers | vector | error code | eip, cs, eflags (from the CPU)
+;
+; Handlers must not use the FPU or SSE: that state is not saved here.
+; ============================================================================
+
+[bits 32]
+[extern interrupt_dispatch]
+
+section .text
+    global idt_load
+    global isr_stub_table
+
+; Vector without a CPU error code
+%macro ISR_NOERR 1
+isr_%1:
+    push dword 0
+    push dword %1
+    jmp isr_common
+%endmacro
+
+; Vector for which the CPU pushes an error code
+%macro ISR_ERR 1
+isr_%1:
+    push dword %1
+    jmp isr_common
+%endmacro
+
+ISR_NOERR 0                 ; Divide error
+ISR_NOERR 1                 ; Debug
+ISR_NOERR 2                 ; NMI
+ISR_NOERR 3                 ; Breakpoint
+ISR_NOERR 4                 ; Overflow
+ISR_NOERR 5                 ; BOUND range exceeded
+ISR_NOERR 6                 ; Invalid opcode
+ISR_NOERR 7                 ; Device not available
+ISR_ERR   8                 ; Double fault
+ISR_NOERR 9                 ; Coprocessor segment overrun
+ISR_ERR   10                ; Invalid TSS
+ISR_ERR   11                ; Segment not present
+ISR_ERR   12                ; Stack fault
+ISR_ERR   13                ; General protection
+ISR_ERR   14                ; Page fault
+ISR_NOERR 15                ; Reserved
+ISR_NOERR 16                ; x87 floating point
+ISR_ERR   17                ; Alignment check
+ISR_NOERR 18                ; Machine check
+ISR_NOERR 19                ; SIMD floating point
+ISR_NOERR 20                ; Virtualization
+ISR_ERR   21                ; Control protection
+ISR_NOERR 22                ; Reserved
+ISR_NOERR 23                ; Reserved
+ISR_NOERR 24                ; Reserved
+ISR_NOERR 25                ; Reserved
+ISR_NOERR 26                ; Reserved
+ISR_NOERR 27                ; Reserved
+ISR_NOERR 28                ; Reserved
+ISR_ERR   29                ; VMM communication
+ISR_ERR   30                ; Security
+ISR_NOERR 31                ; Reserved
+ISR_NOERR 32                ; IRQ 0
+ISR_NOERR 33                ; IRQ 1
+ISR_NOERR 34                ; IRQ 2
+ISR_NOERR 35                ; IRQ 3
+ISR_NOERR 36                ; IRQ 4
+ISR_NOERR 37                ; IRQ 5
+ISR_NOERR 38                ; IRQ 6
+ISR_NOERR 39                ; IRQ 7
+ISR_NOERR 40                ; IRQ 8
+ISR_NOERR 41                ; IRQ 9
+ISR_NOERR 42                ; IRQ 10
+ISR_NOERR 43                ; IRQ 11
+ISR_NOERR 44                ; IRQ 12
+ISR_NOERR 45                ; IRQ 13
+ISR_NOERR 46                ; IRQ 14
+ISR_NOERR 47                ; IRQ 15
+
+; Save the registers and hand the frame to C
+isr_common:
+    pushad
+    cld                     ; The C ABI expects DF clear
+    push esp                ; interrupt_dispatch(InterruptFrame* frame)
+    call interrupt_dispatch
+    add esp, 4
+    popad
+    add esp, 8              ; Drop vector and error code
+    iretd
+
+; Load the IDT register
+; void idt_load(const IdtPointer* idtr)
+idt_load:
+    mov eax, [esp + 4]
+    lidt [eax]
+    ret
+
+section .data
+
+; Stub addresses, indexed by vector
+isr_stub_table:
+%assign v 0
+%rep 48
+    dd isr_ %+ v
+%assign v v + 1
+%endrep
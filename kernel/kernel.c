@@ -3,12 +3,20 @@
  */
 
 #include "kernel.h"
+#include "cpu.h"
+#include "interrupt.h"
+#include "timer.h"
 #include "screen.h"
 #include "keyboard.h"
+#include "serial.h"
 #include "filesystem.h"
 #include "shell.h"
 #include "memory.h"
+#include "memmap.h"
+#include "paging.h"
 #include "ata.h"
+#include "bcache.h"
+#include "pci.h"
 
 /* Print welcome banner */
 static void print_banner(void) {
@@ -26,13 +34,26 @@ static void print_banner(void) {
     screen_print(" Type 'disk' to test disk reading.\n\n");
 }
 
-/* Main kernel function - called from kernel_entry.asm */
-void kernel_main(void) {
+/*
+ * Main kernel function - called from kernel_entry.asm
+ * boot_map: E820 memory map collected by the bootloader
+ */
+void kernel_main(const BootMemoryMap* boot_map) {
     /* Initialize subsystems */
+    cpu_init();     /* Pick memcpy/math kernels before anything uses them */
+    interrupt_init();
+    serial_init();  /* Before the screen, so the console mirrors from the start */
     screen_init();
     keyboard_init();
+    interrupts_enable();
+    timer_init(TIMER_DEFAULT_HZ);
+    memmap_init(boot_map);
     memory_init();
-    ata_init();     /* Initialize disk driver */
+    screen_init_scrollback();
+    paging_init();
+    pci_init();
+    ata_init();     /* Initialize disk driver (uses DMA if PCI has an IDE controller) */
+    bcache_init();
     fs_init();
     shell_init();
     
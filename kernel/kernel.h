@@ -16,9 +16,11 @@
 typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
+typedef unsigned long long uint64_t;
 typedef char int8_t;
 typedef short int16_t;
 typedef int int32_t;
+typedef long long int64_t;
 typedef uint32_t size_t;
 
 #define NULL ((void*)0)
@@ -34,25 +36,52 @@ extern uint8_t port_byte_in(uint16_t port);
 extern void port_byte_out(uint16_t port, uint8_t data);
 extern uint16_t port_word_in(uint16_t port);
 extern void port_word_out(uint16_t port, uint16_t data);
+extern uint32_t port_dword_in(uint16_t port);
+extern void port_dword_out(uint16_t port, uint32_t data);
+
+/* String I/O: move count words/doublewords between a port and a buffer */
+extern void port_words_in(uint16_t port, void* buffer, uint32_t count);
+extern void port_words_out(uint16_t port, const void* buffer, uint32_t count);
+extern void port_dwords_in(uint16_t port, void* buffer, uint32_t count);
+extern void port_dwords_out(uint16_t port, const void* buffer, uint32_t count);
 
 /* ============================================================================
- * Utility Functions
+ * Memory and String Functions (defined in string.c)
  * ============================================================================ */
 
-/* String length */
-static inline size_t strlen(const char* str) {
-    size_t len = 0;
-    while (str[len]) len++;
-    return len;
-}
+void* memcpy(void* dest, const void* src, size_t num);
+void* memmove(void* dest, const void* src, size_t num);
+void* memset(void* ptr, int value, size_t num);
+size_t strlen(const char* str);
+int strcmp(const char* s1, const char* s2);
+void string_benchmark(void);
+
+/* Implementations behind them (picked by cpu_init(), see cpu.h) */
+void* memcpy_generic(void* dest, const void* src, size_t num);
+void* memcpy_sse2(void* dest, const void* src, size_t num);
+void* memmove_generic(void* dest, const void* src, size_t num);
+void* memmove_sse2(void* dest, const void* src, size_t num);
+void* memset_generic(void* ptr, int value, size_t num);
+void* memset_sse2(void* ptr, int value, size_t num);
+size_t strlen_generic(const char* str);
+size_t strlen_sse2(const char* str);
 
-/* String compare */
-static inline int strcmp(const char* s1, const char* s2) {
-    while (*s1 && (*s1 == *s2)) {
-        s1++;
-        s2++;
-    }
-    return *(unsigned char*)s1 - *(unsigned char*)s2;
+/* ============================================================================
+ * Utility Functions
+ * ============================================================================ */
+
+/*
+ * Divide a 64-bit value by a 32-bit one. We do not link libgcc, so plain
+ * 64-bit division is not available; this takes two divl instructions.
+ */
+static inline uint64_t udiv64(uint64_t n, uint32_t d, uint32_t* rem) {
+    uint32_t high = (uint32_t)(n >> 32);
+    uint32_t q_high = high / d;
+    uint32_t r = high % d;
+    uint32_t q_low;
+    __asm__("divl %4" : "=a"(q_low), "=d"(r) : "a"((uint32_t)n), "d"(r), "rm"(d));
+    if (rem) *rem = r;
+    return ((uint64_t)q_high << 32) | q_low;
 }
 
 /* String compare (n characters) */
@@ -81,21 +110,6 @@ static inline char* strncpy(char* dest, const char* src, size_t n) {
     return dest;
 }
 
-/* Memory set */
-static inline void* memset(void* ptr, int value, size_t num) {
-    uint8_t* p = (uint8_t*)ptr;
-    while (num--) *p++ = (uint8_t)value;
-    return ptr;
-}
-
-/* Memory copy */
-static inline void* memcpy(void* dest, const void* src, size_t num) {
-    uint8_t* d = (uint8_t*)dest;
-    const uint8_t* s = (const uint8_t*)src;
-    while (num--) *d++ = *s++;
-    return dest;
-}
-
 /* Convert integer to string */
 static inline void itoa(int value, char* str, int base) {
     char* p = str;
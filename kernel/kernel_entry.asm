@@ -2,12 +2,49 @@
 ; Kernel Entry Point
 ; ============================================================================
 ; This is the entry point for the kernel. It:
-; 1. Calls the main kernel function (written in C)
-; 2. Provides low-level I/O port access functions
+; 1. Zeroes .bss, which is not part of the flat binary the bootloader loads
+; 2. Probes the CPU with CPUID and enables the FPU and SSE/SSE2 if present
+; 3. Calls the main kernel function (written in C), passing it the E820
+;    memory map address the bootloader left in EBX
+; 4. Provides low-level I/O port access functions, including string I/O
+;    (rep ins/outs) for moving whole buffers through a data port
 ; ============================================================================
 
 [bits 32]
 [extern kernel_main]        ; Declare external C function
+[extern __bss_start]        ; From linker.ld
+[extern _kernel_end]
+
+; Control register bits
+CR0_MP          equ 1 << 1  ; Monitor coprocessor
+CR0_EM          equ 1 << 2  ; Emulate FPU (must be clear for x87/SSE)
+CR0_TS          equ 1 << 3  ; Task switched
+CR0_NE          equ 1 << 5  ; Native FPU error reporting
+CR4_OSFXSR      equ 1 << 9  ; OS supports FXSAVE/FXRSTOR (enables SSE)
+CR4_OSXMMEXCPT  equ 1 << 10 ; OS handles SIMD floating-point exceptions
+
+; CPUID leaf 1 EDX bits
+CPUID_FPU       equ 1 << 0
+CPUID_FXSR      equ 1 << 24
+CPUID_SSE       equ 1 << 25
+
+EFLAGS_ID       equ 1 << 21 ; Writable only if CPUID is supported
+
+section .data
+    global cpu_vendor
+    global cpu_max_leaf
+    global cpu_signature
+    global cpu_features_ecx
+    global cpu_features_edx
+    global cpu_sse_enabled
+
+cpu_vendor:         times 13 db 0   ; "GenuineIntel", "AuthenticAMD", ...
+align 4
+cpu_max_leaf:       dd 0            ; Highest basic CPUID leaf
+cpu_signature:      dd 0            ; Leaf 1 EAX: family/model/stepping
+cpu_features_ecx:   dd 0            ; Leaf 1 ECX feature flags
+cpu_features_edx:   dd 0            ; Leaf 1 EDX feature flags
+cpu_sse_enabled:    dd 0            ; 1 once CR4.OSFXSR is set
 
 section .text
     global _start
@@ -15,15 +52,89 @@ section .text
     global port_byte_out
     global port_word_in
     global port_word_out
+    global port_dword_in
+    global port_dword_out
+    global port_words_in
+    global port_words_out
+    global port_dwords_in
+    global port_dwords_out
 
 ; ============================================================================
 ; Entry Point
 ; ============================================================================
 
 _start:
+    cld                     ; Clear .bss (EBX still holds the memory map)
+    mov edi, __bss_start
+    mov ecx, _kernel_end
+    sub ecx, edi
+    xor eax, eax
+    rep stosb
+
+    push ebx                ; kernel_main(const BootMemoryMap* boot_map)
+    call cpu_setup          ; FPU and SSE on before any C code runs
     call kernel_main        ; Call C kernel
     jmp $                   ; Hang if kernel returns
 
+; ============================================================================
+; CPU Setup
+; ============================================================================
+
+; Record the CPUID vendor and feature flags, then turn on the FPU and,
+; when the CPU has FXSR and SSE, the SSE unit. The C code (cpu.c) picks
+; its implementations from what this leaves behind.
+cpu_setup:
+    pushad
+
+    ; CPUID exists if the ID flag can be toggled
+    pushfd
+    pop eax
+    mov ecx, eax
+    xor eax, EFLAGS_ID
+    push eax
+    popfd
+    pushfd
+    pop eax
+    push ecx
+    popfd                   ; Restore the original flags
+    xor eax, ecx
+    jz .done
+
+    xor eax, eax            ; Leaf 0: highest leaf and vendor string
+    cpuid
+    mov [cpu_max_leaf], eax
+    mov [cpu_vendor], ebx
+    mov [cpu_vendor + 4], edx
+    mov [cpu_vendor + 8], ecx
+    cmp eax, 1
+    jb .done
+
+    mov eax, 1              ; Leaf 1: signature and feature flags
+    cpuid
+    mov [cpu_signature], eax
+    mov [cpu_features_ecx], ecx
+    mov [cpu_features_edx], edx
+
+    test edx, CPUID_FPU
+    jz .done
+    mov eax, cr0
+    and eax, ~(CR0_EM | CR0_TS)
+    or eax, CR0_MP | CR0_NE
+    mov cr0, eax
+    fninit
+
+    and edx, CPUID_FXSR | CPUID_SSE
+    cmp edx, CPUID_FXSR | CPUID_SSE
+    jne .done
+    mov eax, cr4
+    or eax, CR4_OSFXSR | CR4_OSXMMEXCPT
+    mov cr4, eax
+    mov dword [cpu_sse_enabled], 1
+
+.done:
+    popad
+    ret
+
 ; ============================================================================
 ; I/O Port Functions
 ; ============================================================================
@@ -57,3 +168,66 @@ port_word_out:
     mov ax, [esp + 8]       ; Data to write
     out dx, ax              ; Write word to port
     ret
+
+; Read a doubleword from an I/O port
+; uint32_t port_dword_in(uint16_t port)
+port_dword_in:
+    mov edx, [esp + 4]      ; Port number
+    in eax, dx              ; Read doubleword from port
+    ret
+
+; Write a doubleword to an I/O port
+; void port_dword_out(uint16_t port, uint32_t data)
+port_dword_out:
+    mov edx, [esp + 4]      ; Port number
+    mov eax, [esp + 8]      ; Data to write
+    out dx, eax             ; Write doubleword to port
+    ret
+
+; Read count words from an I/O port into a buffer
+; void port_words_in(uint16_t port, void* buffer, uint32_t count)
+port_words_in:
+    push edi
+    mov edx, [esp + 8]      ; Port number
+    mov edi, [esp + 12]     ; Destination
+    mov ecx, [esp + 16]     ; Word count
+    cld
+    rep insw
+    pop edi
+    ret
+
+; Write count words from a buffer to an I/O port
+; void port_words_out(uint16_t port, const void* buffer, uint32_t count)
+port_words_out:
+    push esi
+    mov edx, [esp + 8]      ; Port number
+    mov esi, [esp + 12]     ; Source
+    mov ecx, [esp + 16]     ; Word count
+    cld
+    rep outsw
+    pop esi
+    ret
+
+; Read count doublewords from an I/O port into a buffer
+; void port_dwords_in(uint16_t port, void* buffer, uint32_t count)
+port_dwords_in:
+    push edi
+    mov edx, [esp + 8]      ; Port number
+    mov edi, [esp + 12]     ; Destination
+    mov ecx, [esp + 16]     ; Doubleword count
+    cld
+    rep insd
+    pop edi
+    ret
+
+; Write count doublewords from a buffer to an I/O port
+; void port_dwords_out(uint16_t port, const void* buffer, uint32_t count)
+port_dwords_out:
+    push esi
+    mov edx, [esp + 8]      ; Port number
+    mov esi, [esp + 12]     ; Source
+    mov ecx, [esp + 16]     ; Doubleword count
+    cld
+    rep outsd
+    pop esi
+    ret
@@ -2,13 +2,17 @@
  * ============================================================================
  * Keyboard Driver Implementation
  * ============================================================================
- * PS/2 Keyboard driver using port-based I/O
- * Scans for keystrokes and converts scan codes to ASCII
+ * PS/2 Keyboard driver, interrupt driven
+ * The IRQ 1 handler only queues scan codes; converting them to ASCII
+ * happens in the reader. Characters typed on the serial console are
+ * accepted as well.
  * ============================================================================
  */
 
 #include "keyboard.h"
+#include "interrupt.h"
 #include "screen.h"
+#include "serial.h"
 
 /* Keyboard I/O Ports */
 #define KEYBOARD_DATA_PORT   0x60
@@ -17,11 +21,25 @@
 /* Status register bits */
 #define KEYBOARD_OUTPUT_FULL 0x01
 
+#define SCANCODE_MASK (SCANCODE_BUFFER_SIZE - 1)
+
 /* Modifier key states */
 static bool shift_pressed = false;
 static bool caps_lock = false;
 static bool ctrl_pressed = false;
 
+/* The previous byte was KEY_EXTENDED */
+static bool extended = false;
+
+/*
+ * Scan codes from the IRQ handler. Single producer, single consumer: only
+ * the handler advances head and only the reader advances tail, so neither
+ * side needs a lock.
+ */
+static volatile uint8_t scancodes[SCANCODE_BUFFER_SIZE];
+static volatile uint32_t scancode_head = 0;
+static volatile uint32_t scancode_tail = 0;
+
 /* Scan code to ASCII lookup table (US QWERTY layout) */
 static const char scancode_to_ascii[128] = {
     0,    0,   '1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '-', '=',  0,    0,
@@ -50,26 +68,61 @@ static const char scancode_to_ascii_shift[128] = {
  * Keyboard Functions
  * ============================================================================ */
 
+/* IRQ 1: queue the scan code (dropped if the reader is far behind) */
+static void keyboard_irq(InterruptFrame* frame) {
+    (void)frame;
+    
+    uint8_t scancode = port_byte_in(KEYBOARD_DATA_PORT);
+    if (scancode_head - scancode_tail < SCANCODE_BUFFER_SIZE) {
+        scancodes[scancode_head & SCANCODE_MASK] = scancode;
+        scancode_head++;
+    }
+}
+
 /* Initialize keyboard */
 void keyboard_init(void) {
     /* Flush the keyboard buffer */
     while (port_byte_in(KEYBOARD_STATUS_PORT) & KEYBOARD_OUTPUT_FULL) {
         port_byte_in(KEYBOARD_DATA_PORT);
     }
+    
+    scancode_head = 0;
+    scancode_tail = 0;
+    irq_register(IRQ_KEYBOARD, keyboard_irq);
 }
 
 /* Check if a key is available */
 bool keyboard_key_available(void) {
-    return (port_byte_in(KEYBOARD_STATUS_PORT) & KEYBOARD_OUTPUT_FULL) != 0;
+    return scancode_head != scancode_tail;
 }
 
-/* Read a character from keyboard (non-blocking, returns 0 if no key) */
-char keyboard_read_char(void) {
-    if (!keyboard_key_available()) {
+/* Read a character typed on the serial console (0 if none) */
+static char serial_key(void) {
+    char c = serial_read_char();
+    if (c == '\r') return '\n';
+    if (c == 0x7F) return '\b';  /* Terminals send DEL for backspace */
+    return c;
+}
+
+/* Convert one scan code, tracking modifiers (0 if it gives no character) */
+static char scancode_to_char(uint8_t scancode) {
+    if (scancode == KEY_EXTENDED) {
+        extended = true;
         return 0;
     }
     
-    uint8_t scancode = port_byte_in(KEYBOARD_DATA_PORT);
+    /* Shift+PgUp/PgDn page through the scrollback */
+    if (extended) {
+        extended = false;
+        if (shift_pressed && scancode == KEY_PGUP) {
+            screen_scroll_view(SCREEN_HEIGHT - 1);
+            return 0;
+        }
+        if (shift_pressed && scancode == KEY_PGDN) {
+            screen_scroll_view(-(SCREEN_HEIGHT - 1));
+            return 0;
+        }
+    }
     
     /* Check for key release (bit 7 set) */
     if (scancode & 0x80) {
@@ -136,12 +189,29 @@ char keyboard_read_char(void) {
     return c;
 }
 
-/* Wait for a character (blocking) */
+/* Read a character from keyboard (non-blocking, returns 0 if no key) */
+char keyboard_read_char(void) {
+    while (keyboard_key_available()) {
+        uint8_t scancode = scancodes[scancode_tail & SCANCODE_MASK];
+        scancode_tail++;
+        
+        char c = scancode_to_char(scancode);
+        if (c) return c;
+    }
+    return serial_key();
+}
+
+/* Wait for a character (blocking), halting the CPU while there is none */
 char keyboard_wait_char(void) {
     char c;
+    
+    /* Check with interrupts off so a key arriving just before hlt still wakes us */
+    interrupts_disable();
     while ((c = keyboard_read_char()) == 0) {
-        /* Busy wait - no HLT since we don't have interrupts set up */
+        wait_for_interrupt();
+        interrupts_disable();
     }
+    interrupts_enable();
     return c;
 }
 
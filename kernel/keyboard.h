@@ -27,6 +27,14 @@
 #define KEY_DOWN      0x50
 #define KEY_LEFT      0x4B
 #define KEY_RIGHT     0x4D
+#define KEY_PGUP      0x49
+#define KEY_PGDN      0x51
+
+/* Prefix byte for the extended (grey) keys */
+#define KEY_EXTENDED  0xE0
+
+/* Scan codes queued between the IRQ handler and the reader (a power of two) */
+#define SCANCODE_BUFFER_SIZE 64
 
 /* Keyboard Functions */
 void keyboard_init(void);
@@ -15,6 +15,7 @@
  */
 
 #include "math.h"
+#include "cpu.h"
 
 /* ============================================================================
  * Basic Functions
@@ -244,3 +245,32 @@ float tanhf(float x) {
     
     return (ep - em) / (ep + em);
 }
+
+/* ============================================================================
+ * Vector Kernels
+ * ============================================================================ */
+
+/* Dot product of two n-element vectors */
+float vec_dot(const float* a, const float* b, int n) {
+    return kernel_ops.dot(a, b, n);
+}
+
+/* out[d] = w[d][n] * x[n] (w is row-major) */
+void matmul(float* out, const float* x, const float* w, int n, int d) {
+    kernel_ops.matmul(out, x, w, n, d);
+}
+
+/* Plain x87 versions, for CPUs without SSE (see simd.c for the others) */
+float vec_dot_generic(const float* a, const float* b, int n) {
+    float sum = 0.0f;
+    for (int i = 0; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+void matmul_generic(float* out, const float* x, const float* w, int n, int d) {
+    for (int i = 0; i < d; i++) {
+        out[i] = vec_dot_generic(w + i * n, x, n);
+    }
+}
@@ -46,6 +46,16 @@ float tanhf(float x);
 float sqrtf(float x);
 float rsqrtf(float x);  /* Fast reciprocal sqrt */
 
+/* Vector kernels (SSE when the CPU has it, see cpu.h) */
+float vec_dot(const float* a, const float* b, int n);
+void matmul(float* out, const float* x, const float* w, int n, int d);
+
+/* Implementations behind them (picked by cpu_init()) */
+float vec_dot_generic(const float* a, const float* b, int n);
+void matmul_generic(float* out, const float* x, const float* w, int n, int d);
+float vec_dot_sse(const float* a, const float* b, int n);
+void matmul_sse(float* out, const float* x, const float* w, int n, int d);
+
 /* Min/max */
 static inline float fminf(float a, float b) { return a < b ? a : b; }
 static inline float fmaxf(float a, float b) { return a > b ? a : b; }
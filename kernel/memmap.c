@@ -0,0 +1,201 @@
+/*
+ * ============================================================================
+ * Physical Memory Map Implementation
+ * ============================================================================
+ * Turns the raw BIOS E820 map into a sorted list of usable RAM regions.
+ *
+ * - Only type 1 (usable) RAM at or above 1 MB is used; the low megabyte
+ *   holds the kernel image, its stack, the VGA hole and BIOS areas.
+ * - Any range the BIOS reports as non-usable is cut out, even where it
+ *   overlaps a usable entry.
+ * - Regions are page aligned and clipped to the 32-bit address space.
+ * - Without an E820 map we fall back to MEMMAP_FALLBACK_SIZE above 1 MB.
+ * ============================================================================
+ */
+
+#include "memmap.h"
+#include "screen.h"
+#include "printf.h"
+
+/* Top of usable RAM. One page short of 4 GB so that base + size of every
+ * region still fits in 32 bits. */
+#define ADDR_LIMIT (0x100000000ULL - MEMMAP_PAGE_SIZE)
+
+/* Working range with 64-bit ends (E820 entries may lie above 4 GB) */
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+} Range;
+
+/* Copy of the bootloader's map (its memory may be reused later) */
+static BootMemoryMap boot_map;
+
+/* Usable regions, sorted by address */
+static MemRegion regions[MEMMAP_MAX_REGIONS];
+static int region_count = 0;
+static uint32_t usable_bytes = 0;
+
+/* ============================================================================
+ * Internal Functions
+ * ============================================================================ */
+
+/* Remove [start, end) from every range, splitting ranges where needed */
+static int cut_range(Range* ranges, int count, uint64_t start, uint64_t end) {
+    for (int i = 0; i < count; i++) {
+        Range* r = &ranges[i];
+        if (end <= r->start || start >= r->end) continue;
+        
+        if (start > r->start && end < r->end) {
+            /* Hole in the middle: split in two */
+            if (count < MEMMAP_MAX_REGIONS) {
+                ranges[count].start = end;
+                ranges[count].end = r->end;
+                count++;
+            }
+            r->end = start;
+        } else if (start > r->start) {
+            r->end = start;
+        } else if (end < r->end) {
+            r->start = end;
+        } else {
+            r->start = r->end;  /* Fully covered */
+        }
+    }
+    return count;
+}
+
+/* Sort ranges by start address and merge overlapping ones */
+static int sort_and_merge(Range* ranges, int count) {
+    for (int i = 1; i < count; i++) {
+        Range r = ranges[i];
+        int j = i - 1;
+        while (j >= 0 && ranges[j].start > r.start) {
+            ranges[j + 1] = ranges[j];
+            j--;
+        }
+        ranges[j + 1] = r;
+    }
+    
+    int out = 0;
+    for (int i = 0; i < count; i++) {
+        if (ranges[i].start >= ranges[i].end) continue;
+        if (out > 0 && ranges[i].start <= ranges[out - 1].end) {
+            if (ranges[i].end > ranges[out - 1].end) {
+                ranges[out - 1].end = ranges[i].end;
+            }
+        } else {
+            ranges[out++] = ranges[i];
+        }
+    }
+    return out;
+}
+
+static void add_region(uint32_t base, uint32_t size) {
+    regions[region_count].base = base;
+    regions[region_count].size = size;
+    region_count++;
+    usable_bytes += size;
+}
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================ */
+
+/* Build the usable region list from the bootloader's E820 map */
+void memmap_init(const BootMemoryMap* map) {
+    region_count = 0;
+    usable_bytes = 0;
+    boot_map.count = 0;
+    
+    if (!map || map->count == 0 || map->count > E820_MAX_ENTRIES) {
+        add_region(MEMMAP_MIN_ADDR, MEMMAP_FALLBACK_SIZE);
+        return;
+    }
+    
+    memcpy(&boot_map, map, sizeof(boot_map));
+    
+    /* Collect usable RAM, clipped to [1 MB, ADDR_LIMIT) */
+    Range ranges[MEMMAP_MAX_REGIONS];
+    int count = 0;
+    for (uint32_t i = 0; i < boot_map.count; i++) {
+        const E820Entry* e = &boot_map.entries[i];
+        if (e->type != E820_USABLE) continue;
+        
+        uint64_t start = e->base;
+        uint64_t end = e->base + e->length;
+        if (start < MEMMAP_MIN_ADDR) start = MEMMAP_MIN_ADDR;
+        if (end > ADDR_LIMIT) end = ADDR_LIMIT;
+        if (start >= end) continue;
+        
+        ranges[count].start = start;
+        ranges[count].end = end;
+        count++;
+    }
+    count = sort_and_merge(ranges, count);
+    
+    /* Never hand out anything the BIOS says is not plain RAM */
+    for (uint32_t i = 0; i < boot_map.count; i++) {
+        const E820Entry* e = &boot_map.entries[i];
+        if (e->type == E820_USABLE) continue;
+        count = cut_range(ranges, count, e->base, e->base + e->length);
+    }
+    count = sort_and_merge(ranges, count);
+    
+    /* Keep whole pages only */
+    for (int i = 0; i < count; i++) {
+        uint64_t start = (ranges[i].start + MEMMAP_PAGE_SIZE - 1) &
+                         ~(uint64_t)(MEMMAP_PAGE_SIZE - 1);
+        uint64_t end = ranges[i].end & ~(uint64_t)(MEMMAP_PAGE_SIZE - 1);
+        if (end > start) {
+            add_region((uint32_t)start, (uint32_t)(end - start));
+        }
+    }
+    
+    /* A map with no usable high memory is no better than none */
+    if (region_count == 0) {
+        add_region(MEMMAP_MIN_ADDR, MEMMAP_FALLBACK_SIZE);
+    }
+}
+
+/* Get the usable regions; returns their count */
+int memmap_get_regions(const MemRegion** out) {
+    *out = regions;
+    return region_count;
+}
+
+/* Total usable bytes across all regions */
+uint32_t memmap_get_usable(void) {
+    return usable_bytes;
+}
+
+/* Print the raw E820 map and the regions built from it */
+void memmap_dump(void) {
+    static const char* type_names[] = {
+        "?", "usable", "reserved", "ACPI data", "ACPI NVS", "bad"
+    };
+    
+    screen_print_color("\n=== Physical Memory Map ===\n", INFO_COLOR);
+    
+    if (boot_map.count == 0) {
+        kprintf("No E820 map from BIOS, assuming %u MB at 1 MB\n",
+                MEMMAP_FALLBACK_SIZE / (1024 * 1024));
+    }
+    
+    for (uint32_t i = 0; i < boot_map.count; i++) {
+        const E820Entry* e = &boot_map.entries[i];
+        screen_print("  0x");
+        if (e->base >> 32) {
+            kprintf("%x:", (uint32_t)(e->base >> 32));
+        }
+        kprintf("%x  %u KB  %s\n", (uint32_t)e->base, (uint32_t)(e->length >> 10),
+                e->type <= E820_BAD ? type_names[e->type] : "?");
+    }
+    
+    screen_print_color("Usable regions:\n", INFO_COLOR);
+    for (int i = 0; i < region_count; i++) {
+        kprintf("  0x%x - 0x%x  (%u KB)\n", regions[i].base,
+                regions[i].base + regions[i].size, regions[i].size / 1024);
+    }
+    
+    kprintf("Total usable: %u MB\n\n", usable_bytes / (1024 * 1024));
+}
@@ -0,0 +1,56 @@
+/*
+ * ============================================================================
+ * Physical Memory Map Header
+ * ============================================================================
+ * BIOS E820 memory map, collected by the bootloader
+ * ============================================================================
+ */
+
+#ifndef MEMMAP_H
+#define MEMMAP_H
+
+#include "kernel.h"
+
+/* Must match E820_MAX_ENTRIES in boot/boot.asm */
+#define E820_MAX_ENTRIES 32
+
+/* E820 region types */
+#define E820_USABLE      1
+#define E820_RESERVED    2
+#define E820_ACPI_RECLAIM 3
+#define E820_ACPI_NVS    4
+#define E820_BAD         5
+
+/* One entry as returned by INT 15h, AX=E820h */
+typedef struct __attribute__((packed)) {
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+    uint32_t acpi;
+} E820Entry;
+
+/* Map left by the bootloader: entry count followed by the entries */
+typedef struct __attribute__((packed)) {
+    uint32_t count;
+    E820Entry entries[E820_MAX_ENTRIES];
+} BootMemoryMap;
+
+/* A usable RAM range (page aligned) */
+typedef struct {
+    uint32_t base;
+    uint32_t size;
+} MemRegion;
+
+/* Memory map configuration */
+#define MEMMAP_MIN_ADDR      0x100000                /* Ignore RAM below 1 MB */
+#define MEMMAP_MAX_REGIONS   (E820_MAX_ENTRIES * 2)  /* Room for splits */
+#define MEMMAP_FALLBACK_SIZE (64 * 1024 * 1024)      /* Assumed without E820 */
+#define MEMMAP_PAGE_SIZE     4096
+
+/* Memory map functions */
+void memmap_init(const BootMemoryMap* map);
+int  memmap_get_regions(const MemRegion** regions);
+uint32_t memmap_get_usable(void);
+void memmap_dump(void);
+
+#endif /* MEMMAP_H */
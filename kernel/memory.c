@@ -2,32 +2,42 @@
  * ============================================================================
  * Memory Allocator Implementation
  * ============================================================================
- * A simple first-fit heap allocator for MyOS.
+ * A segregated-fit heap allocator for MyOS.
  *
  * Features:
- * - First-fit allocation strategy
- * - Block coalescing on free
- * - 8-byte alignment
+ * - Size-class bins holding only free blocks (O(1) small allocations)
+ * - Bitmap of non-empty bins to find the next larger class quickly
+ * - Boundary tags (footers on free blocks) for O(1) coalescing on free
+ * - Live statistics and size histograms (no heap walk to report usage)
+ * - realloc() grows and shrinks in place when the neighbour allows it
+ * - 8-byte header on allocated blocks
+ * - 8-byte alignment, up to MAX_ALLOC_ALIGN through aligned_alloc()
+ * - Heap grows in chunks of pages from the buddy allocator, and gives
+ *   a chunk back once it is entirely free
+ * - Requests of LARGE_ALLOC_THRESHOLD or more go straight to pages
  * - Magic number validation
  * ============================================================================
  */
 
 #include "memory.h"
+#include "memmap.h"
+#include "buddy.h"
 #include "screen.h"
+#include "printf.h"
 
 /*
- * Heap memory starts after the kernel.
- * Defined in linker.ld
+ * Small blocks live in chunks of pages taken from the buddy allocator.
+ * Blocks tile each chunk back to back.
  */
-extern uint32_t _kernel_end;
-
-/* Head of the free list */
-static BlockHeader *heap_start = NULL;
+static HeapChunk *chunks = NULL;
 static bool heap_initialized = false;
 
+/* Segregated free lists and a bitmap of which bins are non-empty */
+static BlockHeader *bins[NUM_BINS];
+static uint32_t bin_map[(NUM_BINS + 31) / 32];
+
 /* Statistics */
-static size_t total_allocated = 0;
-static size_t total_freed = 0;
+static MemoryStats stats;
 static size_t num_allocations = 0;
 
 /* ============================================================================
@@ -50,56 +60,415 @@ static BlockHeader *data_to_header(void *ptr) {
   return (BlockHeader *)((uint8_t *)ptr - HEADER_SIZE);
 }
 
+/* Size of a block without its flag bits */
+static size_t block_size(BlockHeader *block) {
+  return block->size & ~BLOCK_FLAGS;
+}
+
+static bool block_is_free(BlockHeader *block) {
+  return (block->size & BLOCK_FREE) != 0;
+}
+
+/* Next block by address, or NULL at the fence ending its chunk */
+static BlockHeader *next_block(BlockHeader *block) {
+  BlockHeader *next = (BlockHeader *)((uint8_t *)block + block_size(block));
+  return next->magic == FENCE_MAGIC ? NULL : next;
+}
+
+/* First block of a chunk */
+static BlockHeader *chunk_first_block(HeapChunk *chunk) {
+  return (BlockHeader *)((uint8_t *)chunk + sizeof(HeapChunk));
+}
+
+/* Previous block by address; only valid when BLOCK_PREV_FREE is set */
+static BlockHeader *prev_free_block(BlockHeader *block) {
+  uint32_t prev_size = *((uint32_t *)block - 1);
+  return (BlockHeader *)((uint8_t *)block - prev_size);
+}
+
+/* Copy the block size into its footer */
+static void write_footer(BlockHeader *block) {
+  size_t size = block_size(block);
+  *(uint32_t *)((uint8_t *)block + size - FOOTER_SIZE) = size;
+}
+
+/* Flag a block free, write its footer and tell its right neighbour */
+static void mark_free(BlockHeader *block) {
+  block->size |= BLOCK_FREE;
+  write_footer(block);
+  BlockHeader *next = next_block(block);
+  if (next) {
+    next->size |= BLOCK_PREV_FREE;
+  }
+}
+
+/* Flag a block allocated and tell its right neighbour */
+static void mark_used(BlockHeader *block) {
+  block->size &= ~BLOCK_FREE;
+  BlockHeader *next = next_block(block);
+  if (next) {
+    next->size &= ~BLOCK_PREV_FREE;
+  }
+}
+
+/*
+ * Alignment of an aligned_alloc() block, used when realloc() has to move it.
+ * The payload address is aligned at least as strictly as was requested, so
+ * its lowest set bit (capped at MAX_ALLOC_ALIGN) is a safe alignment to keep.
+ */
+static size_t block_alignment(void *ptr) {
+  uint32_t addr = (uint32_t)ptr;
+  size_t align = addr & -addr;
+  return align > MAX_ALLOC_ALIGN ? MAX_ALLOC_ALIGN : align;
+}
+
 /* Validate a block header */
 static bool is_valid_block(BlockHeader *block) {
   if (!block)
     return false;
+  if (!buddy_contains(block))
+    return false;
   if (block->magic != BLOCK_MAGIC)
     return false;
   return true;
 }
 
-/* Split a block if it's large enough */
+/* Free list links live in the payload of a free block */
+static FreeLinks *links(BlockHeader *block) {
+  return (FreeLinks *)header_to_data(block);
+}
+
+/* Map a payload size to its size-class bin */
+static int bin_index(size_t payload) {
+  if (payload < SMALL_BIN_LIMIT) {
+    return (payload - MIN_BLOCK_SIZE) / BLOCK_ALIGN;
+  }
+  /* floor(log2(payload)), payload >= 256 so this is >= 8 */
+  return NUM_SMALL_BINS + (31 - __builtin_clz(payload)) - 8;
+}
+
+/* Histogram bucket of a payload size: floor(log2(payload)) */
+static int hist_bucket(size_t payload) {
+  return 31 - __builtin_clz(payload);
+}
+
+/*
+ * Page-backed blocks: the header sits just below the payload, inside the
+ * first page, and its size is the byte length of the whole page run.
+ */
+static uint8_t *large_base(BlockHeader *block) {
+  return (uint8_t *)((uint32_t)block & ~(PAGE_SIZE - 1));
+}
+
+static size_t large_capacity(BlockHeader *block) {
+  return large_base(block) + block_size(block) -
+         (uint8_t *)header_to_data(block);
+}
+
+/* Usable bytes of an allocated block */
+static size_t block_payload(BlockHeader *block) {
+  if (block->magic == LARGE_MAGIC)
+    return large_capacity(block);
+  return block_size(block) - HEADER_SIZE;
+}
+
+/* Count a block that was just handed out */
+static void account_alloc(BlockHeader *block) {
+  size_t payload = block_payload(block);
+
+  if (block->magic == LARGE_MAGIC) {
+    stats.large_blocks++;
+    stats.large_bytes += payload;
+  }
+  stats.used_bytes += payload;
+  stats.used_blocks++;
+  stats.used_hist[hist_bucket(payload)]++;
+  if (stats.used_bytes > stats.peak_used) {
+    stats.peak_used = stats.used_bytes;
+  }
+}
+
+/* Uncount a block that is about to be freed */
+static void account_free(BlockHeader *block) {
+  size_t payload = block_payload(block);
+
+  if (block->magic == LARGE_MAGIC) {
+    stats.large_blocks--;
+    stats.large_bytes -= payload;
+  }
+  stats.used_bytes -= payload;
+  stats.used_blocks--;
+  stats.used_hist[hist_bucket(payload)]--;
+}
+
+/* Insert a free block at the head of its bin */
+static void bin_insert(BlockHeader *block) {
+  size_t payload = block_size(block) - HEADER_SIZE;
+  int idx = bin_index(payload);
+  FreeLinks *l = links(block);
+
+  stats.free_bytes += payload;
+  stats.free_blocks++;
+  stats.free_hist[hist_bucket(payload)]++;
+
+  l->prev_free = NULL;
+  l->next_free = bins[idx];
+  if (bins[idx]) {
+    links(bins[idx])->prev_free = block;
+  }
+  bins[idx] = block;
+  bin_map[idx / 32] |= 1u << (idx % 32);
+}
+
+/* Unlink a free block from its bin */
+static void bin_remove(BlockHeader *block) {
+  size_t payload = block_size(block) - HEADER_SIZE;
+  int idx = bin_index(payload);
+  FreeLinks *l = links(block);
+
+  stats.free_bytes -= payload;
+  stats.free_blocks--;
+  stats.free_hist[hist_bucket(payload)]--;
+
+  if (l->prev_free) {
+    links(l->prev_free)->next_free = l->next_free;
+  } else {
+    bins[idx] = l->next_free;
+  }
+  if (l->next_free) {
+    links(l->next_free)->prev_free = l->prev_free;
+  }
+  if (!bins[idx]) {
+    bin_map[idx / 32] &= ~(1u << (idx % 32));
+  }
+}
+
+/* Find the first non-empty bin at or above idx, or -1 */
+static int bin_next_nonempty(int idx) {
+  for (int word = idx / 32; word < (NUM_BINS + 31) / 32; word++) {
+    uint32_t bits = bin_map[word];
+    if (word == idx / 32) {
+      bits &= ~0u << (idx % 32);
+    }
+    if (bits) {
+      return word * 32 + __builtin_ctz(bits);
+    }
+  }
+  return -1;
+}
+
+/* Find a free block with at least `size` payload bytes and unlink it */
+static BlockHeader *find_free_block(size_t size) {
+  int idx = bin_index(size);
+
+  /* Large bins hold a range of sizes, so check the home bin first-fit */
+  if (idx >= NUM_SMALL_BINS) {
+    for (BlockHeader *b = bins[idx]; b; b = links(b)->next_free) {
+      if (block_size(b) - HEADER_SIZE >= size) {
+        bin_remove(b);
+        return b;
+      }
+    }
+    idx++;
+  }
+
+  /* Every block in a higher bin is big enough - take the head */
+  idx = bin_next_nonempty(idx);
+  if (idx < 0) {
+    return NULL;
+  }
+  BlockHeader *block = bins[idx];
+  bin_remove(block);
+  return block;
+}
+
+/*
+ * Split a block if it's large enough, returning the tail to the bins.
+ * The tail's right neighbour already has BLOCK_PREV_FREE set because the
+ * whole block was free; the caller marks the head used.
+ */
 static void split_block(BlockHeader *block, size_t size) {
   size_t total_needed = HEADER_SIZE + size;
-  size_t remaining = block->size - total_needed;
+  size_t remaining = block_size(block) - total_needed;
 
   /* Only split if remaining space can hold a useful block */
   if (remaining >= HEADER_SIZE + MIN_BLOCK_SIZE) {
     BlockHeader *new_block = (BlockHeader *)((uint8_t *)block + total_needed);
-    new_block->size = remaining;
-    new_block->is_free = 1;
+    new_block->size = remaining | BLOCK_FREE;
     new_block->magic = BLOCK_MAGIC;
-    new_block->next = block->next;
-    new_block->prev = block;
-
-    if (block->next) {
-      block->next->prev = new_block;
-    }
+    write_footer(new_block);
 
-    block->next = new_block;
-    block->size = total_needed;
+    block->size = total_needed | (block->size & BLOCK_FLAGS);
+    bin_insert(new_block);
   }
 }
 
-/* Coalesce adjacent free blocks */
-static void coalesce(BlockHeader *block) {
+/*
+ * Coalesce a newly freed block with its free neighbours in O(1).
+ * The right neighbour is found by size, the left one through its footer.
+ * Neighbours are pulled out of their bins; the caller bins the result.
+ */
+static BlockHeader *coalesce(BlockHeader *block) {
+  size_t size = block_size(block);
+
   /* Coalesce with next block if free */
-  if (block->next && block->next->is_free) {
-    block->size += block->next->size;
-    block->next = block->next->next;
-    if (block->next) {
-      block->next->prev = block;
-    }
+  BlockHeader *next = next_block(block);
+  if (next && block_is_free(next)) {
+    bin_remove(next);
+    size += block_size(next);
   }
 
   /* Coalesce with previous block if free */
-  if (block->prev && block->prev->is_free) {
-    block->prev->size += block->size;
-    block->prev->next = block->next;
-    if (block->next) {
-      block->next->prev = block->prev;
-    }
+  if (block->size & BLOCK_PREV_FREE) {
+    block = prev_free_block(block);
+    bin_remove(block);
+    size += block_size(block);
+  }
+
+  block->size = size | (block->size & BLOCK_FLAGS);
+  mark_free(block);
+  return block;
+}
+
+/*
+ * Cut an allocated block down to `size` payload bytes, giving the tail
+ * back to the heap (merged with a free right neighbour if there is one).
+ */
+static void trim_block(BlockHeader *block, size_t size) {
+  size_t total_needed = HEADER_SIZE + size;
+  size_t remaining = block_size(block) - total_needed;
+
+  if (remaining < HEADER_SIZE + MIN_BLOCK_SIZE)
+    return;
+
+  BlockHeader *tail = (BlockHeader *)((uint8_t *)block + total_needed);
+  tail->size = remaining;
+  tail->magic = BLOCK_MAGIC;
+  block->size = total_needed | (block->size & BLOCK_FLAGS);
+
+  bin_insert(coalesce(tail));
+}
+
+/* Turn a run of pages into a heap chunk holding one free block */
+static void heap_add_chunk(uint32_t base, uint32_t size) {
+  HeapChunk *chunk = (HeapChunk *)base;
+  chunk->size = size;
+
+  /* Keep the chunk list in address order */
+  HeapChunk **link = &chunks;
+  while (*link && *link < chunk) {
+    link = &(*link)->next;
+  }
+  chunk->next = *link;
+  *link = chunk;
+
+  BlockHeader *fence = (BlockHeader *)(base + size - HEADER_SIZE);
+  fence->size = HEADER_SIZE;
+  fence->magic = FENCE_MAGIC;
+
+  BlockHeader *block = chunk_first_block(chunk);
+  block->size = (uint8_t *)fence - (uint8_t *)block;
+  block->magic = BLOCK_MAGIC;
+  mark_free(block);
+  bin_insert(block);
+
+  stats.heap_chunks++;
+  stats.heap_bytes += size;
+}
+
+/* Take a new chunk of pages big enough for `size` payload bytes */
+static bool heap_grow(size_t size) {
+  size_t bytes = sizeof(HeapChunk) + 2 * HEADER_SIZE + size;
+  if (bytes < HEAP_GROW_SIZE) {
+    bytes = HEAP_GROW_SIZE;
+  }
+
+  uint32_t pages = (bytes + PAGE_SIZE - 1) >> PAGE_SHIFT;
+  void *base = buddy_alloc_pages(pages);
+  if (!base)
+    return false;
+
+  heap_add_chunk((uint32_t)base, pages << PAGE_SHIFT);
+  return true;
+}
+
+/*
+ * If a coalesced free block now spans its whole chunk, give the chunk's
+ * pages back (keeping the last chunk to avoid churn). The block must not
+ * be in a bin. Returns true if the chunk was released.
+ */
+static bool heap_release_chunk(BlockHeader *block) {
+  if (next_block(block) || (block->size & BLOCK_PREV_FREE))
+    return false;
+
+  HeapChunk **link = &chunks;
+  while (*link && chunk_first_block(*link) != block) {
+    link = &(*link)->next;
+  }
+
+  HeapChunk *chunk = *link;
+  if (!chunk || (chunk == chunks && !chunk->next))
+    return false;
+
+  *link = chunk->next;
+  stats.heap_chunks--;
+  stats.heap_bytes -= chunk->size;
+  buddy_free_pages(chunk, chunk->size >> PAGE_SHIFT);
+  return true;
+}
+
+/* Find a free block for `size` payload bytes, growing the heap if needed */
+static BlockHeader *take_free_block(size_t size) {
+  BlockHeader *block = find_free_block(size);
+  if (!block && heap_grow(size)) {
+    block = find_free_block(size);
+  }
+  return block;
+}
+
+/* Allocate a page-backed block with its payload aligned to align */
+static void *large_alloc(size_t size, size_t align) {
+  size_t offset = align > HEADER_SIZE ? align : HEADER_SIZE;
+  if (size > (size_t)-1 - offset - (PAGE_SIZE - 1))
+    return NULL;
+  uint32_t pages = (offset + size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+
+  uint8_t *base = (uint8_t *)buddy_alloc_pages(pages);
+  if (!base)
+    return NULL;
+
+  BlockHeader *block = (BlockHeader *)(base + offset - HEADER_SIZE);
+  block->size = pages << PAGE_SHIFT;
+  block->magic = LARGE_MAGIC;
+  if (align > BLOCK_ALIGN) {
+    block->size |= BLOCK_ALIGNED;
+  }
+
+  account_alloc(block);
+  num_allocations++;
+
+  return header_to_data(block);
+}
+
+/* Give a page-backed block's pages back */
+static void large_free(BlockHeader *block) {
+  account_free(block);
+  block->magic = 0; /* Catch a second free of the same pointer */
+  buddy_free_pages(large_base(block), block_size(block) >> PAGE_SHIFT);
+}
+
+/* Shrink a page-backed block to `size` payload bytes, freeing whole pages */
+static void large_trim(BlockHeader *block, size_t size) {
+  uint8_t *base = large_base(block);
+  size_t offset = (uint8_t *)header_to_data(block) - base;
+  uint32_t pages = block_size(block) >> PAGE_SHIFT;
+  uint32_t keep = (offset + size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+
+  if (keep < pages) {
+    account_free(block);
+    buddy_free_pages(base + (keep << PAGE_SHIFT), pages - keep);
+    block->size = (keep << PAGE_SHIFT) | (block->size & BLOCK_FLAGS);
+    account_alloc(block);
   }
 }
 
@@ -108,35 +477,30 @@ static void coalesce(BlockHeader *block) {
  * ============================================================================
  */
 
-/* Initialize the heap */
+/* Initialize the allocator (memmap_init() runs first) */
 void memory_init(void) {
   if (heap_initialized)
     return;
 
-  /* Calculate heap start address (aligned) */
-  uint32_t kernel_end_addr = (uint32_t)&_kernel_end;
-  uint32_t heap_start_addr =
-      (kernel_end_addr + BLOCK_ALIGN - 1) & ~(BLOCK_ALIGN - 1);
+  memset(bins, 0, sizeof(bins));
+  memset(bin_map, 0, sizeof(bin_map));
+  memset(&stats, 0, sizeof(stats));
+  num_allocations = 0;
+  chunks = NULL;
 
-  /* Create initial free block spanning entire heap */
-  heap_start = (BlockHeader *)heap_start_addr;
-  heap_start->size = HEAP_SIZE;
-  heap_start->is_free = 1;
-  heap_start->next = NULL;
-  heap_start->prev = NULL;
-  heap_start->magic = BLOCK_MAGIC;
+  const MemRegion *regions;
+  if (memmap_get_regions(&regions) == 0) {
+    /* No map yet (malloc() before memmap_init()): use the fallback */
+    memmap_init(NULL);
+  }
 
+  /* All RAM goes to the page allocator; the heap takes chunks on demand */
+  buddy_init();
   heap_initialized = true;
-  total_allocated = 0;
-  total_freed = 0;
-  num_allocations = 0;
 
-  screen_print("Heap initialized at: ");
-  char buf[32];
-  itoa(heap_start_addr, buf, 16);
-  screen_print("0x");
-  screen_print(buf);
-  screen_print("\n");
+  BuddyStats pages;
+  buddy_get_stats(&pages);
+  kprintf("Memory initialized: %u MB in 4 KB pages\n", pages.total_pages / 256);
 }
 
 /* Allocate memory */
@@ -148,31 +512,30 @@ void *malloc(size_t size) {
   if (size == 0)
     return NULL;
 
+  /* Big requests get their own pages */
+  if (size >= LARGE_ALLOC_THRESHOLD) {
+    return large_alloc(size, BLOCK_ALIGN);
+  }
+
   /* Align the requested size */
   size = align_size(size);
   if (size < MIN_BLOCK_SIZE) {
     size = MIN_BLOCK_SIZE;
   }
 
-  /* First-fit search */
-  BlockHeader *current = heap_start;
-  while (current) {
-    if (current->is_free && current->size >= HEADER_SIZE + size) {
-      /* Found a suitable block */
-      split_block(current, size);
-      current->is_free = 0;
-
-      /* Update statistics */
-      total_allocated += current->size;
-      num_allocations++;
-
-      return header_to_data(current);
-    }
-    current = current->next;
+  /* Segregated-fit search: only free blocks are ever visited */
+  BlockHeader *block = take_free_block(size);
+  if (!block) {
+    /* No suitable block found */
+    return NULL;
   }
 
-  /* No suitable block found */
-  return NULL;
+  split_block(block, size);
+  mark_used(block);
+  account_alloc(block);
+  num_allocations++;
+
+  return header_to_data(block);
 }
 
 /* Free memory */
@@ -182,29 +545,103 @@ void free(void *ptr) {
 
   BlockHeader *block = data_to_header(ptr);
 
+  if (buddy_contains(block) && block->magic == LARGE_MAGIC) {
+    large_free(block);
+    return;
+  }
+
   /* Validate block */
   if (!is_valid_block(block)) {
     screen_print_color("ERROR: Invalid free() - bad pointer!\n", ERROR_COLOR);
     return;
   }
 
-  if (block->is_free) {
+  if (block_is_free(block)) {
     screen_print_color("ERROR: Double free detected!\n", ERROR_COLOR);
     return;
   }
 
-  /* Mark as free */
-  block->is_free = 1;
-  total_freed += block->size;
+  account_free(block);
+  block->size &= ~BLOCK_ALIGNED;
 
-  /* Coalesce with adjacent free blocks */
-  coalesce(block);
+  /* Coalesce with adjacent free blocks and return the result to a bin */
+  block = coalesce(block);
+  if (!heap_release_chunk(block)) {
+    bin_insert(block);
+  }
 }
 
-/* Allocate and zero memory */
+/*
+ * Allocate memory whose address is a multiple of align (a power of two).
+ * The block is a normal heap or page-backed block, so free() and
+ * realloc() work on it.
+ */
+void *aligned_alloc(size_t align, size_t size) {
+  if (align & (align - 1))
+    return NULL;
+  if (align <= BLOCK_ALIGN)
+    return malloc(size);
+  if (align > MAX_ALLOC_ALIGN || size == 0)
+    return NULL;
+
+  if (!heap_initialized) {
+    memory_init();
+  }
+
+  if (size >= LARGE_ALLOC_THRESHOLD) {
+    return large_alloc(size, align);
+  }
+
+  size = align_size(size);
+  if (size < MIN_BLOCK_SIZE) {
+    size = MIN_BLOCK_SIZE;
+  }
+
+  /* Leave room to skip to an aligned address and free what we skip */
+  BlockHeader *block =
+      take_free_block(size + align + HEADER_SIZE + MIN_BLOCK_SIZE);
+  if (!block) {
+    return NULL;
+  }
+
+  uint32_t data = (uint32_t)header_to_data(block);
+  uint32_t aligned = (data + align - 1) & ~(align - 1);
+  if (aligned != data && aligned - data < HEADER_SIZE + MIN_BLOCK_SIZE) {
+    aligned += align;
+  }
+
+  /* Give the leading gap back to the bins as its own free block */
+  if (aligned != data) {
+    size_t gap = aligned - data;
+    size_t rest = block_size(block) - gap;
+    BlockHeader *front = block;
+
+    block = data_to_header((void *)aligned);
+    block->size = rest | BLOCK_FREE | BLOCK_PREV_FREE;
+    block->magic = BLOCK_MAGIC;
+
+    front->size = gap | (front->size & BLOCK_FLAGS);
+    write_footer(front);
+    bin_insert(front);
+  }
+
+  split_block(block, size);
+  mark_used(block);
+  block->size |= BLOCK_ALIGNED;
+  account_alloc(block);
+  num_allocations++;
+
+  return header_to_data(block);
+}
+
+/* Allocate and zero memory (large buffers start on a cache line) */
 void *calloc(size_t num, size_t size) {
+  if (size && num > (size_t)-1 / size)
+    return NULL;
   size_t total = num * size;
-  void *ptr = malloc(total);
+  void *ptr = total >= CALLOC_ALIGN_THRESHOLD
+                  ? aligned_alloc(CACHE_LINE_SIZE, total)
+                  : malloc(total);
   if (ptr) {
     memset(ptr, 0, total);
   }
@@ -223,106 +660,172 @@ void *realloc(void *ptr, size_t new_size) {
   }
 
   BlockHeader *block = data_to_header(ptr);
-  if (!is_valid_block(block)) {
+
+  /* Page-backed: shrink by returning whole pages, otherwise move */
+  if (buddy_contains(block) && block->magic == LARGE_MAGIC) {
+    size_t capacity = large_capacity(block);
+    if (new_size <= capacity) {
+      large_trim(block, new_size);
+      return ptr;
+    }
+
+    void *new_ptr = (block->size & BLOCK_ALIGNED)
+                        ? aligned_alloc(block_alignment(ptr), new_size)
+                        : malloc(new_size);
+    if (new_ptr) {
+      memcpy(new_ptr, ptr, capacity);
+      free(ptr);
+    }
+    return new_ptr;
+  }
+
+  if (!is_valid_block(block) || block_is_free(block)) {
     return NULL;
   }
 
-  size_t old_size = block->size - HEADER_SIZE;
+  size_t old_size = block_size(block) - HEADER_SIZE;
 
-  /* If new size fits in current block, just return */
-  if (new_size <= old_size) {
-    return ptr;
+  /* Large sizes go to pages (and would wrap align_size); just move */
+  if (new_size < LARGE_ALLOC_THRESHOLD) {
+    size_t size = align_size(new_size);
+    if (size < MIN_BLOCK_SIZE) {
+      size = MIN_BLOCK_SIZE;
+    }
+
+    /* Shrink in place, giving the tail back */
+    if (size <= old_size) {
+      account_free(block);
+      trim_block(block, size);
+      account_alloc(block);
+      return ptr;
+    }
+
+    /* Grow in place by absorbing a free right neighbour */
+    BlockHeader *next = next_block(block);
+    if (next && block_is_free(next) && old_size + block_size(next) >= size) {
+      account_free(block);
+      bin_remove(next);
+      block->size += block_size(next);
+      mark_used(block);
+      trim_block(block, size);
+      account_alloc(block);
+      return ptr;
+    }
   }
 
-  /* Allocate new block and copy */
-  void *new_ptr = malloc(new_size);
+  /* Allocate new block (keeping any alignment) and copy */
+  void *new_ptr = (block->size & BLOCK_ALIGNED)
+                      ? aligned_alloc(block_alignment(ptr), new_size)
+                      : malloc(new_size);
   if (new_ptr) {
-    memcpy(new_ptr, ptr, old_size);
+    memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
     free(ptr);
   }
 
   return new_ptr;
 }
 
-/* Get total free memory */
-size_t memory_get_free(void) {
-  size_t free_mem = 0;
-  BlockHeader *current = heap_start;
-
-  while (current) {
-    if (current->is_free) {
-      free_mem += current->size - HEADER_SIZE;
+/* Payload of the largest free block: scan only the highest non-empty bin */
+static size_t largest_free_block(void) {
+  for (int word = (NUM_BINS + 31) / 32 - 1; word >= 0; word--) {
+    if (!bin_map[word])
+      continue;
+
+    int idx = word * 32 + 31 - __builtin_clz(bin_map[word]);
+    size_t largest = 0;
+    for (BlockHeader *b = bins[idx]; b; b = links(b)->next_free) {
+      if (block_size(b) > largest) {
+        largest = block_size(b);
+      }
     }
-    current = current->next;
+    return largest - HEADER_SIZE;
   }
+  return 0;
+}
+
+/* Print the lower bound of a histogram bucket, e.g. "64KB" */
+static void print_bucket_size(int bucket) {
+  if (bucket >= 20) {
+    kprintf("%uMB", 1u << (bucket - 20));
+  } else if (bucket >= 10) {
+    kprintf("%uKB", 1u << (bucket - 10));
+  } else {
+    kprintf("%uB", 1u << bucket);
+  }
+}
 
-  return free_mem;
+/* Get total free memory (free heap blocks plus free pages) */
+size_t memory_get_free(void) {
+  BuddyStats pages;
+  buddy_get_stats(&pages);
+  return stats.free_bytes + ((size_t)pages.free_pages << PAGE_SHIFT);
 }
 
 /* Get total used memory */
 size_t memory_get_used(void) {
-  size_t used_mem = 0;
-  BlockHeader *current = heap_start;
-
-  while (current) {
-    if (!current->is_free) {
-      used_mem += current->size - HEADER_SIZE;
-    }
-    current = current->next;
-  }
+  return stats.used_bytes;
+}
 
-  return used_mem;
+/* Snapshot of the live heap statistics */
+void memory_get_stats(MemoryStats *out) {
+  *out = stats;
+  out->largest_free = largest_free_block();
 }
 
 /* Dump heap status for debugging */
 void memory_dump(void) {
   screen_print_color("\n=== Heap Memory Status ===\n", INFO_COLOR);
 
-  char buf[64];
-
-  screen_print("Total heap size: ");
-  itoa(HEAP_SIZE / 1024, buf, 10);
-  screen_print(buf);
-  screen_print(" KB\n");
-
-  screen_print("Used memory:     ");
-  itoa(memory_get_used() / 1024, buf, 10);
-  screen_print(buf);
-  screen_print(" KB\n");
-
-  screen_print("Free memory:     ");
-  itoa(memory_get_free() / 1024, buf, 10);
-  screen_print(buf);
-  screen_print(" KB\n");
-
-  screen_print("Allocations:     ");
-  itoa(num_allocations, buf, 10);
-  screen_print(buf);
-  screen_print("\n");
+  MemoryStats st;
+  memory_get_stats(&st);
+
+  kprintf("Heap chunks:     %u KB in %u chunks\n", st.heap_bytes / 1024,
+          st.heap_chunks);
+  kprintf("Used memory:     %u KB in %u blocks (peak %u KB)\n",
+          st.used_bytes / 1024, st.used_blocks, st.peak_used / 1024);
+  kprintf("Free memory:     %u KB in %u blocks (largest %u KB)\n",
+          st.free_bytes / 1024, st.free_blocks, st.largest_free / 1024);
+  kprintf("Page-backed:     %u KB in %u blocks\n", st.large_bytes / 1024,
+          st.large_blocks);
+  kprintf("Allocations:     %u\n", num_allocations);
+
+  int bins_used = 0;
+  for (int i = 0; i < NUM_BINS; i++) {
+    if (bins[i])
+      bins_used++;
+  }
+  kprintf("Free bins:       %d of %d in use\n", bins_used, NUM_BINS);
+
+  /* Show live blocks by size class */
+  screen_print_color("\nSize histogram (used / free blocks):\n", INFO_COLOR);
+  for (int i = 0; i < HIST_BUCKETS; i++) {
+    if (!st.used_hist[i] && !st.free_hist[i])
+      continue;
+    screen_print("  >= ");
+    print_bucket_size(i);
+    kprintf(": %u / %u\n", st.used_hist[i], st.free_hist[i]);
+  }
 
   /* Show block list */
   screen_print_color("\nBlock list:\n", INFO_COLOR);
-  BlockHeader *current = heap_start;
+  HeapChunk *chunk = chunks;
+  BlockHeader *current = chunk ? chunk_first_block(chunk) : NULL;
   int block_num = 0;
 
   while (current && block_num < 10) { /* Limit display */
-    screen_print("  [");
-    itoa(block_num, buf, 10);
-    screen_print(buf);
-    screen_print("] ");
-
-    itoa(current->size / 1024, buf, 10);
-    screen_print(buf);
-    screen_print("KB ");
-
-    if (current->is_free) {
+    kprintf("  [%d] %uKB ", block_num, block_size(current) / 1024);
+    if (block_is_free(current)) {
       screen_print_color("FREE", PROMPT_COLOR);
     } else {
       screen_print_color("USED", ERROR_COLOR);
     }
     screen_print("\n");
 
-    current = current->next;
+    current = next_block(current);
+    if (!current && chunk->next) {
+      chunk = chunk->next;
+      current = chunk_first_block(chunk);
+    }
     block_num++;
   }
 
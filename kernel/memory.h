@@ -12,22 +12,90 @@
 #include "kernel.h"
 
 /* Heap configuration */
-/* Heap configuration */
-#define HEAP_SIZE (128 * 1024 * 1024) /* 128 MB heap limit */
 #define BLOCK_ALIGN 8                 /* 8-byte alignment */
 #define MIN_BLOCK_SIZE 16             /* Minimum allocation */
 
-/* Memory block header */
+/* Page-backed allocation */
+#define LARGE_ALLOC_THRESHOLD (64 * 1024) /* Sizes that go straight to pages */
+#define HEAP_GROW_SIZE (1024 * 1024)      /* Pages taken per heap chunk */
+
+/* Aligned allocation */
+#define CACHE_LINE_SIZE 64            /* calloc() alignment for large buffers */
+#define CALLOC_ALIGN_THRESHOLD 1024   /* calloc() sizes that get CACHE_LINE_SIZE */
+#define MAX_ALLOC_ALIGN 4096          /* Largest alignment aligned_alloc() takes */
+
+/*
+ * Segregated free lists (size classes by payload size)
+ * - Payloads below SMALL_BIN_LIMIT get one exact bin per BLOCK_ALIGN step,
+ *   so a small malloc() is a pop from the head of its bin.
+ * - Larger payloads share one bin per power of two.
+ */
+#define SMALL_BIN_LIMIT 256
+#define NUM_SMALL_BINS ((SMALL_BIN_LIMIT - MIN_BLOCK_SIZE) / BLOCK_ALIGN)
+#define NUM_LARGE_BINS 24 /* 2^8 .. 2^31 */
+#define NUM_BINS (NUM_SMALL_BINS + NUM_LARGE_BINS)
+
+/*
+ * Memory block header (boundary tags)
+ * Blocks are laid out back to back, so the next block is found by adding
+ * the size. Free blocks also keep FreeLinks at the start of the payload and
+ * a footer (copy of the size) in their last 4 bytes, which lets free() find
+ * a free left neighbour in O(1). Allocated blocks carry only this header.
+ */
 typedef struct BlockHeader {
-  uint32_t size;            /* Size of this block (including header) */
-  uint32_t is_free;         /* 1 if free, 0 if allocated */
-  struct BlockHeader *next; /* Next block in list */
-  struct BlockHeader *prev; /* Previous block in list */
-  uint32_t magic;           /* Magic number for validation */
+  uint32_t size;  /* Size of this block (including header) | BLOCK_* flags */
+  uint32_t magic; /* Magic number for validation */
 } BlockHeader;
 
+/* Flags kept in the low bits of BlockHeader.size */
+#define BLOCK_FREE 0x1      /* This block is free */
+#define BLOCK_PREV_FREE 0x2 /* The block before this one is free */
+#define BLOCK_ALIGNED 0x4   /* Allocated by aligned_alloc() */
+#define BLOCK_FLAGS (BLOCK_ALIGN - 1)
+
+/* Doubly linked free list, stored in the payload of free blocks only */
+typedef struct FreeLinks {
+  struct BlockHeader *next_free; /* Next free block in the same bin */
+  struct BlockHeader *prev_free; /* Previous free block in the same bin */
+} FreeLinks;
+
+/*
+ * Heap statistics, kept up to date by every malloc()/free()/realloc() so
+ * reading them never walks the heap. Histograms count live blocks per
+ * power-of-two payload size: bucket n holds sizes 2^n .. 2^(n+1)-1.
+ */
+#define HIST_BUCKETS 32
+
+typedef struct MemoryStats {
+  size_t used_bytes;     /* Payload bytes in allocated blocks */
+  size_t free_bytes;     /* Payload bytes in free heap blocks */
+  size_t peak_used;      /* Highest used_bytes seen */
+  size_t largest_free;   /* Payload of the largest free heap block */
+  uint32_t used_blocks;  /* Allocated blocks */
+  uint32_t free_blocks;  /* Free heap blocks */
+  uint32_t large_blocks; /* Allocated blocks backed directly by pages */
+  size_t large_bytes;    /* Payload bytes in those blocks */
+  uint32_t heap_chunks;  /* Chunks the small-block heap holds */
+  size_t heap_bytes;     /* Bytes in those chunks */
+  uint32_t used_hist[HIST_BUCKETS]; /* Allocated blocks by size */
+  uint32_t free_hist[HIST_BUCKETS]; /* Free blocks by size */
+} MemoryStats;
+
+/*
+ * Heap chunk: a run of pages taken from the buddy allocator.
+ * Blocks tile the chunk after this header and end at a fence, a
+ * permanently allocated header with FENCE_MAGIC that stops coalescing.
+ */
+typedef struct HeapChunk {
+  struct HeapChunk *next; /* Next chunk (by address) */
+  uint32_t size;          /* Chunk size in bytes, including header and fence */
+} HeapChunk;
+
 #define BLOCK_MAGIC 0xDEADBEEF
+#define FENCE_MAGIC 0xFEEDFACE
+#define LARGE_MAGIC 0xB16B10C5 /* Header of a page-backed allocation */
 #define HEADER_SIZE sizeof(BlockHeader)
+#define FOOTER_SIZE sizeof(uint32_t)
 
 /* Memory functions */
 void memory_init(void);
@@ -35,10 +103,12 @@ void *malloc(size_t size);
 void free(void *ptr);
 void *calloc(size_t num, size_t size);
 void *realloc(void *ptr, size_t new_size);
+void *aligned_alloc(size_t align, size_t size);
 
 /* Debug functions */
 void memory_dump(void);
 size_t memory_get_free(void);
 size_t memory_get_used(void);
+void memory_get_stats(MemoryStats *out);
 
 #endif /* MEMORY_H */
@@ -0,0 +1,376 @@
+/*
+ * ============================================================================
+ * Paging Implementation
+ * ============================================================================
+ * Turns on 32-bit paging with an identity map of everything the kernel
+ * touches, so pointers keep meaning physical addresses.
+ *
+ * - Usable RAM is mapped with 4 MB (PSE) pages wherever it is 4 MB
+ *   aligned, so a sweep over a big buffer costs one TLB entry per 4 MB.
+ *   Unaligned edges, and CPUs without PSE, get 4 KB pages.
+ * - The low megabyte (kernel image, stack, E820 map) is mapped with 4 KB
+ *   pages, except page 0, which is left unmapped to catch NULL pointers.
+ * - The VGA text buffer is write-combining when the CPU has a PAT
+ *   (PAT entry 1 is reprogrammed from write-through to WC), and
+ *   uncacheable otherwise. Buffered writes drain before any IN/OUT.
+ * - Kernel mappings are global, so they survive CR3 reloads.
+ * - Page directory and page tables come from the buddy allocator.
+ * ============================================================================
+ */
+
+#include "paging.h"
+#include "cpu.h"
+#include "buddy.h"
+#include "memmap.h"
+#include "screen.h"
+#include "printf.h"
+
+/* Low memory mapped at boot: page 1 up to the VGA hole */
+#define LOW_MEM_END   0xA0000
+#define VGA_TEXT_SIZE 0x8000         /* 0xB8000 - 0xBFFFF */
+
+/* Control register bits */
+#define CR0_PG        0x80000000
+#define CR4_PSE       0x00000010
+#define CR4_PGE       0x00000080
+
+/* Page attribute table MSR; entry 1 (PWT=1) becomes write-combining */
+#define MSR_PAT       0x277
+#define PAT_TYPE_WC   0x01
+
+#define ENTRIES_PER_TABLE 1024
+#define PDE_INDEX(v)  ((v) >> 22)
+#define PTE_INDEX(v)  (((v) >> 12) & 0x3FF)
+
+static uint32_t* page_dir = NULL;
+static bool paging_on = false;
+static bool has_pse = false;
+static bool has_pge = false;
+static bool has_pat = false;
+
+/* Mapping statistics */
+static uint32_t large_pages = 0;
+static uint32_t small_pages = 0;
+static uint32_t page_tables = 0;
+
+/* ============================================================================
+ * Internal Functions
+ * ============================================================================ */
+
+static uint64_t read_msr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static void write_msr(uint32_t msr, uint64_t value) {
+    __asm__ volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+/* Drop any TLB entry (4 KB or 4 MB) covering addr */
+static void flush_tlb(uint32_t addr) {
+    if (paging_on) {
+        __asm__ volatile ("invlpg (%0)" : : "r"(addr) : "memory");
+    }
+}
+
+/* Make PAT entry 1 write-combining (caches and TLBs flushed around it) */
+static void setup_pat(void) {
+    uint64_t pat = read_msr(MSR_PAT);
+    pat &= ~(0xFFULL << 8);
+    pat |= (uint64_t)PAT_TYPE_WC << 8;
+
+    __asm__ volatile ("wbinvd" : : : "memory");
+    write_msr(MSR_PAT, pat);
+    __asm__ volatile ("wbinvd" : : : "memory");
+}
+
+/* Hardware bits for a set of MAP_* flags */
+static uint32_t entry_bits(uint32_t flags) {
+    uint32_t bits = PTE_PRESENT;
+
+    if (flags & MAP_WRITE) bits |= PTE_WRITABLE;
+    if (flags & MAP_USER) bits |= PTE_USER;
+    if ((flags & MAP_GLOBAL) && has_pge) bits |= PTE_GLOBAL;
+
+    if (flags & MAP_UNCACHED) {
+        bits |= PTE_CACHE_DISABLE | PTE_WRITE_THROUGH;
+    } else if (flags & MAP_WRITE_COMBINE) {
+        bits |= has_pat ? PTE_WRITE_THROUGH : PTE_CACHE_DISABLE | PTE_WRITE_THROUGH;
+    }
+    return bits;
+}
+
+/* Fresh, empty page table for the directory entry pde */
+static uint32_t* new_table(uint32_t* pde) {
+    uint32_t* table = (uint32_t*)buddy_alloc(0);
+    if (!table) return NULL;
+
+    memset(table, 0, PAGING_PAGE_SIZE);
+    *pde = (uint32_t)table | PTE_PRESENT | PTE_WRITABLE | PTE_USER;
+    page_tables++;
+    return table;
+}
+
+/* Replace a 4 MB page with a page table of 1024 equivalent 4 KB pages */
+static uint32_t* split_large(uint32_t* pde) {
+    uint32_t large = *pde;
+    uint32_t base = large & PDE_LARGE_MASK;
+    uint32_t bits = large & (PTE_PRESENT | PTE_WRITABLE | PTE_USER |
+                             PTE_WRITE_THROUGH | PTE_CACHE_DISABLE | PTE_GLOBAL);
+    if (large & PDE_LARGE_PAT) bits |= PTE_PAT;
+
+    uint32_t* table = new_table(pde);
+    if (!table) {
+        *pde = large;
+        return NULL;
+    }
+
+    for (int i = 0; i < ENTRIES_PER_TABLE; i++) {
+        table[i] = (base + i * PAGING_PAGE_SIZE) | bits;
+    }
+    flush_tlb(base);
+
+    large_pages--;
+    small_pages += ENTRIES_PER_TABLE;
+    return table;
+}
+
+/* Name of the memory type an entry's cache bits select */
+static const char* cache_name(uint32_t entry) {
+    switch (entry & (PTE_CACHE_DISABLE | PTE_WRITE_THROUGH)) {
+        case 0:                 return "WB";
+        case PTE_WRITE_THROUGH: return has_pat ? "WC" : "WT";
+        case PTE_CACHE_DISABLE: return "UC-";
+        default:                return "UC";
+    }
+}
+
+/* Print one run of identical mappings */
+static void dump_run(uint32_t start, uint32_t end, uint32_t entry, bool large) {
+    kprintf("  0x%x - 0x%x  %s %s %s\n", start, end, cache_name(entry),
+            (entry & PTE_WRITABLE) ? "RW" : "RO", large ? "4M" : "4K");
+}
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================ */
+
+/* Build the identity map and switch paging on */
+void paging_init(void) {
+    has_pse = cpu_has(CPU_PSE);
+    has_pge = cpu_has(CPU_PGE);
+    has_pat = cpu_has(CPU_PAT | CPU_MSR);
+
+    page_dir = (uint32_t*)buddy_alloc(0);
+    if (!page_dir) {
+        screen_print_color("Paging: no memory for page directory\n", ERROR_COLOR);
+        return;
+    }
+    memset(page_dir, 0, PAGING_PAGE_SIZE);
+
+    if (has_pat) {
+        setup_pat();
+    }
+
+    /* Low memory (page 0 stays unmapped) and the VGA text buffer */
+    int result = paging_map(PAGING_PAGE_SIZE, PAGING_PAGE_SIZE,
+                            LOW_MEM_END - PAGING_PAGE_SIZE, MAP_WRITE | MAP_GLOBAL);
+    if (result == PAGING_SUCCESS) {
+        result = paging_map(VIDEO_MEMORY, VIDEO_MEMORY, VGA_TEXT_SIZE,
+                            MAP_WRITE | MAP_WRITE_COMBINE | MAP_GLOBAL);
+    }
+
+    /* All usable RAM */
+    const MemRegion* regions;
+    int count = memmap_get_regions(&regions);
+    for (int i = 0; i < count && result == PAGING_SUCCESS; i++) {
+        result = paging_map(regions[i].base, regions[i].base, regions[i].size,
+                            MAP_WRITE | MAP_GLOBAL);
+    }
+
+    if (result != PAGING_SUCCESS) {
+        screen_print_color("Paging: failed to build identity map\n", ERROR_COLOR);
+        return;
+    }
+
+    /* Load the directory, enable large and global pages, then paging */
+    uint32_t cr4;
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(cr4));
+    if (has_pse) cr4 |= CR4_PSE;
+    if (has_pge) cr4 |= CR4_PGE;
+    __asm__ volatile ("mov %0, %%cr4" : : "r"(cr4));
+    __asm__ volatile ("mov %0, %%cr3" : : "r"(page_dir) : "memory");
+
+    uint32_t cr0;
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(cr0));
+    cr0 |= CR0_PG;
+    __asm__ volatile ("mov %0, %%cr0" : : "r"(cr0) : "memory");
+    paging_on = true;
+
+    kprintf("Paging enabled: %u x 4 MB + %u x 4 KB pages\n", large_pages, small_pages);
+}
+
+/*
+ * Map [virt, virt + size) to [phys, phys + size). All three must be page
+ * aligned and the range must not already be mapped. 4 MB pages are used
+ * wherever both addresses are 4 MB aligned. On PAGING_ERR_NOMEM the
+ * range may be partly mapped.
+ */
+int paging_map(uint32_t virt, uint32_t phys, uint32_t size, uint32_t flags) {
+    if (!page_dir) return PAGING_ERR_NOMEM;
+    if ((virt | phys | size) & (PAGING_PAGE_SIZE - 1)) return PAGING_ERR_RANGE;
+    if (size == 0) return PAGING_SUCCESS;
+    if (virt + size - 1 < virt || phys + size - 1 < phys) return PAGING_ERR_RANGE;
+
+    uint32_t unused;
+    for (uint32_t offset = 0; offset < size; offset += PAGING_PAGE_SIZE) {
+        if (paging_translate(virt + offset, &unused)) return PAGING_ERR_MAPPED;
+    }
+
+    uint32_t bits = entry_bits(flags);
+
+    while (size > 0) {
+        uint32_t* pde = &page_dir[PDE_INDEX(virt)];
+        uint32_t step = PAGING_PAGE_SIZE;
+
+        if (has_pse && !(*pde & PTE_PRESENT) && size >= PAGING_LARGE_SIZE &&
+            !((virt | phys) & (PAGING_LARGE_SIZE - 1))) {
+            *pde = phys | bits | PDE_LARGE;
+            step = PAGING_LARGE_SIZE;
+            large_pages++;
+        } else {
+            uint32_t* table = (*pde & PTE_PRESENT)
+                              ? (uint32_t*)(*pde & PTE_FRAME_MASK)
+                              : new_table(pde);
+            if (!table) return PAGING_ERR_NOMEM;
+
+            table[PTE_INDEX(virt)] = phys | bits;
+            small_pages++;
+        }
+
+        flush_tlb(virt);
+        virt += step;
+        phys += step;
+        size -= step;
+    }
+    return PAGING_SUCCESS;
+}
+
+/*
+ * Unmap [virt, virt + size), which must be page aligned. Unmapped pages
+ * in the range are skipped. A 4 MB page that is only partly unmapped is
+ * split into 4 KB pages first.
+ */
+int paging_unmap(uint32_t virt, uint32_t size) {
+    if (!page_dir) return PAGING_ERR_NOMEM;
+    if ((virt | size) & (PAGING_PAGE_SIZE - 1)) return PAGING_ERR_RANGE;
+    if (size != 0 && virt + size - 1 < virt) return PAGING_ERR_RANGE;
+
+    while (size > 0) {
+        uint32_t* pde = &page_dir[PDE_INDEX(virt)];
+        uint32_t step = PAGING_PAGE_SIZE;
+
+        if (!(*pde & PTE_PRESENT)) {
+            /* Nothing mapped up to the next 4 MB boundary */
+            step = PAGING_LARGE_SIZE - (virt & (PAGING_LARGE_SIZE - 1));
+            if (step > size) step = size;
+        } else if (*pde & PDE_LARGE) {
+            if (!(virt & (PAGING_LARGE_SIZE - 1)) && size >= PAGING_LARGE_SIZE) {
+                *pde = 0;
+                step = PAGING_LARGE_SIZE;
+                large_pages--;
+                flush_tlb(virt);
+            } else if (!split_large(pde)) {
+                return PAGING_ERR_NOMEM;
+            } else {
+                continue;   /* Unmap from the new page table */
+            }
+        } else {
+            uint32_t* pte = &((uint32_t*)(*pde & PTE_FRAME_MASK))[PTE_INDEX(virt)];
+            if (*pte & PTE_PRESENT) {
+                *pte = 0;
+                small_pages--;
+                flush_tlb(virt);
+            }
+        }
+
+        virt += step;
+        size -= step;
+    }
+    return PAGING_SUCCESS;
+}
+
+/* Look up the physical address virt maps to; false if unmapped */
+bool paging_translate(uint32_t virt, uint32_t* phys) {
+    if (!page_dir) return false;
+
+    uint32_t pde = page_dir[PDE_INDEX(virt)];
+    if (!(pde & PTE_PRESENT)) return false;
+
+    if (pde & PDE_LARGE) {
+        *phys = (pde & PDE_LARGE_MASK) | (virt & (PAGING_LARGE_SIZE - 1));
+        return true;
+    }
+
+    uint32_t pte = ((uint32_t*)(pde & PTE_FRAME_MASK))[PTE_INDEX(virt)];
+    if (!(pte & PTE_PRESENT)) return false;
+
+    *phys = (pte & PTE_FRAME_MASK) | (virt & (PAGING_PAGE_SIZE - 1));
+    return true;
+}
+
+/* True once paging_init() has switched paging on */
+bool paging_enabled(void) {
+    return paging_on;
+}
+
+/* Print CPU features, page counts and the mapped ranges */
+void paging_dump(void) {
+    screen_print_color("\n=== Paging ===\n", INFO_COLOR);
+    if (!paging_on) {
+        screen_print("Paging is off\n");
+        return;
+    }
+
+    kprintf("CPU: PSE %s, PGE %s, PAT %s\n", has_pse ? "yes" : "no",
+            has_pge ? "yes" : "no", has_pat ? "yes" : "no");
+    kprintf("Pages: %u x 4 MB, %u x 4 KB in %u page tables\n",
+            large_pages, small_pages, page_tables);
+
+    /* Merge neighbouring entries with the same attributes into runs */
+    uint32_t attr_mask = PTE_WRITABLE | PTE_USER | PTE_WRITE_THROUGH | PTE_CACHE_DISABLE;
+    uint32_t run_start = 0, run_end = 0, run_entry = 0;
+    bool run_large = false, in_run = false;
+
+    for (uint32_t i = 0; i < ENTRIES_PER_TABLE; i++) {
+        uint32_t pde = page_dir[i];
+        bool large = (pde & PDE_LARGE) != 0;
+        int entries = (pde & PTE_PRESENT) && !large ? ENTRIES_PER_TABLE : 1;
+
+        for (int j = 0; j < entries; j++) {
+            uint32_t entry = entries == 1 ? pde : ((uint32_t*)(pde & PTE_FRAME_MASK))[j];
+            uint32_t start = (i << 22) | (j << 12);
+
+            if (!(entry & PTE_PRESENT)) {
+                if (in_run) dump_run(run_start, run_end, run_entry, run_large);
+                in_run = false;
+                continue;
+            }
+
+            if (in_run && start == run_end && large == run_large &&
+                (entry & attr_mask) == (run_entry & attr_mask)) {
+                run_end = start + (large ? PAGING_LARGE_SIZE : PAGING_PAGE_SIZE);
+                continue;
+            }
+
+            if (in_run) dump_run(run_start, run_end, run_entry, run_large);
+            in_run = true;
+            run_start = start;
+            run_end = start + (large ? PAGING_LARGE_SIZE : PAGING_PAGE_SIZE);
+            run_entry = entry;
+            run_large = large;
+        }
+    }
+    if (in_run) dump_run(run_start, run_end, run_entry, run_large);
+}
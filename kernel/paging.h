@@ -0,0 +1,56 @@
+/*
+ * ============================================================================
+ * Paging Header
+ * ============================================================================
+ * Identity-mapped 32-bit paging with 4 MB (PSE) pages and cache attributes
+ * ============================================================================
+ */
+
+#ifndef PAGING_H
+#define PAGING_H
+
+#include "kernel.h"
+
+/* Page and large page sizes */
+#define PAGING_PAGE_SIZE  0x1000      /* 4 KB */
+#define PAGING_LARGE_SIZE 0x400000    /* 4 MB (needs CPU PSE support) */
+
+/* Hardware entry bits (page directory and page table entries) */
+#define PTE_PRESENT       0x001
+#define PTE_WRITABLE      0x002
+#define PTE_USER          0x004
+#define PTE_WRITE_THROUGH 0x008       /* PWT */
+#define PTE_CACHE_DISABLE 0x010       /* PCD */
+#define PTE_ACCESSED      0x020
+#define PTE_DIRTY         0x040
+#define PTE_PAT           0x080       /* PAT bit in a 4 KB page table entry */
+#define PDE_LARGE         0x080       /* PS bit: 4 MB page */
+#define PTE_GLOBAL        0x100
+#define PDE_LARGE_PAT     0x1000      /* PAT bit in a 4 MB directory entry */
+#define PTE_FRAME_MASK    0xFFFFF000
+#define PDE_LARGE_MASK    0xFFC00000
+
+/* Mapping flags for paging_map() */
+#define MAP_WRITE         0x01        /* Writable */
+#define MAP_USER          0x02        /* Accessible from ring 3 */
+#define MAP_UNCACHED      0x04        /* Strong uncacheable (MMIO registers) */
+#define MAP_WRITE_COMBINE 0x08        /* Write-combining (frame buffers) */
+#define MAP_GLOBAL        0x10        /* Survives CR3 reloads */
+
+/* Error codes */
+#define PAGING_SUCCESS     0
+#define PAGING_ERR_RANGE  -1          /* Unaligned, or wraps past 4 GB */
+#define PAGING_ERR_NOMEM  -2          /* No page for a new page table */
+#define PAGING_ERR_MAPPED -3          /* Range already (partly) mapped */
+
+/* Paging functions (paging_init() needs the page allocator) */
+void paging_init(void);
+int  paging_map(uint32_t virt, uint32_t phys, uint32_t size, uint32_t flags);
+int  paging_unmap(uint32_t virt, uint32_t size);
+bool paging_translate(uint32_t virt, uint32_t* phys);
+bool paging_enabled(void);
+
+/* Debug functions */
+void paging_dump(void);
+
+#endif /* PAGING_H */
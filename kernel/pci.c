@@ -0,0 +1,157 @@
+/*
+ * ============================================================================
+ * PCI Bus Implementation
+ * ============================================================================
+ * Configuration space through mechanism #1: write the bus/device/function
+ * and register to 0xCF8, then move the dword at 0xCFC. Narrower accesses
+ * read the whole dword and pick out their part.
+ *
+ * pci_init() probes every bus and slot once and keeps what it finds, so
+ * drivers can look up their controller without touching the bus again.
+ * ============================================================================
+ */
+
+#include "pci.h"
+#include "printf.h"
+#include "screen.h"
+
+static PciDevice devices[PCI_MAX_DEVICES];
+static int num_devices = 0;
+
+/* ============================================================================
+ * Internal Functions
+ * ============================================================================ */
+
+static uint32_t config_address(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset) {
+    return 0x80000000 | ((uint32_t)bus << 16) | ((uint32_t)(device & 0x1F) << 11) |
+           ((uint32_t)(function & 0x07) << 8) | (offset & 0xFC);
+}
+
+static uint32_t read32(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset) {
+    port_dword_out(PCI_CONFIG_ADDRESS, config_address(bus, device, function, offset));
+    return port_dword_in(PCI_CONFIG_DATA);
+}
+
+/* Remember one function, if there is room */
+static void add_function(uint8_t bus, uint8_t device, uint8_t function) {
+    if (num_devices >= PCI_MAX_DEVICES) return;
+
+    PciDevice* dev = &devices[num_devices++];
+    dev->bus = bus;
+    dev->device = device;
+    dev->function = function;
+
+    uint32_t id = read32(bus, device, function, PCI_VENDOR_ID);
+    dev->vendor_id = id & 0xFFFF;
+    dev->device_id = id >> 16;
+
+    uint32_t class_reg = read32(bus, device, function, 0x08);
+    dev->prog_if = (class_reg >> 8) & 0xFF;
+    dev->subclass = (class_reg >> 16) & 0xFF;
+    dev->class_code = class_reg >> 24;
+
+    dev->irq_line = read32(bus, device, function, PCI_INTERRUPT_LINE) & 0xFF;
+    for (int i = 0; i < 6; i++) {
+        dev->bar[i] = read32(bus, device, function, PCI_BAR0 + i * 4);
+    }
+}
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================ */
+
+/* Enumerate every function on every bus */
+void pci_init(void) {
+    num_devices = 0;
+
+    for (int bus = 0; bus < 256; bus++) {
+        for (int device = 0; device < 32; device++) {
+            if ((read32(bus, device, 0, PCI_VENDOR_ID) & 0xFFFF) == 0xFFFF) continue;
+
+            /* Header type bit 7: the device has functions 1-7 as well */
+            uint8_t header = (read32(bus, device, 0, 0x0C) >> 16) & 0xFF;
+            int functions = (header & 0x80) ? 8 : 1;
+
+            for (int function = 0; function < functions; function++) {
+                if ((read32(bus, device, function, PCI_VENDOR_ID) & 0xFFFF) != 0xFFFF) {
+                    add_function(bus, device, function);
+                }
+            }
+        }
+    }
+}
+
+uint32_t pci_config_read32(const PciDevice* dev, uint8_t offset) {
+    return read32(dev->bus, dev->device, dev->function, offset);
+}
+
+uint16_t pci_config_read16(const PciDevice* dev, uint8_t offset) {
+    return (pci_config_read32(dev, offset) >> ((offset & 2) * 8)) & 0xFFFF;
+}
+
+uint8_t pci_config_read8(const PciDevice* dev, uint8_t offset) {
+    return (pci_config_read32(dev, offset) >> ((offset & 3) * 8)) & 0xFF;
+}
+
+void pci_config_write32(const PciDevice* dev, uint8_t offset, uint32_t value) {
+    port_dword_out(PCI_CONFIG_ADDRESS, config_address(dev->bus, dev->device, dev->function, offset));
+    port_dword_out(PCI_CONFIG_DATA, value);
+}
+
+/*
+ * Write 16 bits, keeping the other half of the dword. STATUS, the upper
+ * half of COMMAND's dword, is write-1-to-clear, so it is written as 0
+ * rather than echoed back (which would clear its error bits).
+ */
+void pci_config_write16(const PciDevice* dev, uint8_t offset, uint16_t value) {
+    uint32_t shift = (offset & 2) * 8;
+    uint32_t dword = pci_config_read32(dev, offset);
+    if ((offset & ~3) == PCI_COMMAND) {
+        dword &= 0xFFFF;
+    }
+    dword = (dword & ~(0xFFFFu << shift)) | ((uint32_t)value << shift);
+    pci_config_write32(dev, offset, dword);
+}
+
+/* First function with the given class and subclass, or NULL */
+const PciDevice* pci_find_class(uint8_t class_code, uint8_t subclass) {
+    for (int i = 0; i < num_devices; i++) {
+        if (devices[i].class_code == class_code && devices[i].subclass == subclass) {
+            return &devices[i];
+        }
+    }
+    return NULL;
+}
+
+/* Turn on PCI_COMMAND_* bits (I/O decode, bus mastering, ...) */
+void pci_enable(const PciDevice* dev, uint16_t command_bits) {
+    uint16_t command = pci_config_read16(dev, PCI_COMMAND);
+    if ((command & command_bits) != command_bits) {
+        pci_config_write16(dev, PCI_COMMAND, command | command_bits);
+    }
+}
+
+int pci_device_count(void) {
+    return num_devices;
+}
+
+/* List the functions found by pci_init() */
+void pci_dump(void) {
+    screen_print_color("\n=== PCI Devices ===\n", INFO_COLOR);
+    if (num_devices == 0) {
+        screen_print("None found\n");
+        return;
+    }
+
+    kprintf("%-9s%-11s%-10s%-4s%s\n", "Slot", "Vendor:Dev", "Class", "IRQ", "BARs");
+    for (int i = 0; i < num_devices; i++) {
+        const PciDevice* dev = &devices[i];
+        kprintf("%02x:%02x.%u  %04x:%04x  %02x.%02x.%02x  %-4u",
+                dev->bus, dev->device, dev->function, dev->vendor_id, dev->device_id,
+                dev->class_code, dev->subclass, dev->prog_if, dev->irq_line);
+        for (int b = 0; b < 6; b++) {
+            if (dev->bar[b]) kprintf("%u:%x ", b, dev->bar[b]);
+        }
+        screen_print("\n");
+    }
+}
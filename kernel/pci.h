@@ -0,0 +1,75 @@
+/*
+ * ============================================================================
+ * PCI Bus Header
+ * ============================================================================
+ * Configuration space access and device enumeration
+ * ============================================================================
+ */
+
+#ifndef PCI_H
+#define PCI_H
+
+#include "kernel.h"
+
+/* Configuration mechanism #1 ports */
+#define PCI_CONFIG_ADDRESS   0xCF8
+#define PCI_CONFIG_DATA      0xCFC
+
+/* Configuration space registers (type 0 header) */
+#define PCI_VENDOR_ID        0x00
+#define PCI_DEVICE_ID        0x02
+#define PCI_COMMAND          0x04
+#define PCI_STATUS           0x06
+#define PCI_PROG_IF          0x09
+#define PCI_SUBCLASS         0x0A
+#define PCI_CLASS            0x0B
+#define PCI_HEADER_TYPE      0x0E
+#define PCI_BAR0             0x10
+#define PCI_INTERRUPT_LINE   0x3C
+
+/* Command register bits */
+#define PCI_COMMAND_IO       0x0001
+#define PCI_COMMAND_MEMORY   0x0002
+#define PCI_COMMAND_MASTER   0x0004
+
+/* Classes we look for */
+#define PCI_CLASS_STORAGE    0x01
+#define PCI_SUBCLASS_IDE     0x01
+
+/* IDE programming interface bit: controller can do bus-master DMA */
+#define PCI_IDE_BUS_MASTER   0x80
+
+/* A BAR with bit 0 set decodes I/O space */
+#define PCI_BAR_IO           0x01
+#define PCI_BAR_IO_MASK      0xFFFFFFFC
+#define PCI_BAR_MEM_MASK     0xFFFFFFF0
+
+/* Devices remembered by pci_init() */
+#define PCI_MAX_DEVICES      32
+
+typedef struct {
+    uint8_t bus;
+    uint8_t device;
+    uint8_t function;
+    uint8_t class_code;
+    uint8_t subclass;
+    uint8_t prog_if;
+    uint8_t irq_line;
+    uint16_t vendor_id;
+    uint16_t device_id;
+    uint32_t bar[6];
+} PciDevice;
+
+/* Functions */
+void pci_init(void);
+uint32_t pci_config_read32(const PciDevice* dev, uint8_t offset);
+uint16_t pci_config_read16(const PciDevice* dev, uint8_t offset);
+uint8_t  pci_config_read8(const PciDevice* dev, uint8_t offset);
+void pci_config_write32(const PciDevice* dev, uint8_t offset, uint32_t value);
+void pci_config_write16(const PciDevice* dev, uint8_t offset, uint16_t value);
+const PciDevice* pci_find_class(uint8_t class_code, uint8_t subclass);
+void pci_enable(const PciDevice* dev, uint16_t command_bits);
+int  pci_device_count(void);
+void pci_dump(void);
+
+#endif /* PCI_H */
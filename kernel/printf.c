@@ -0,0 +1,310 @@
+/*
+ * ============================================================================
+ * Kernel printf Implementation
+ * ============================================================================
+ * One formatter behind ksnprintf() and kprintf(). Output goes through a
+ * small buffer: ksnprintf() truncates when it fills up, kprintf() hands
+ * it to the console. A call that prints less than KPRINTF_BUFFER_SIZE
+ * characters reaches the screen as one write, with one cursor update.
+ * ============================================================================
+ */
+
+#include "printf.h"
+#include "screen.h"
+
+/* Largest %f precision (10^9 still fits in 32 bits) */
+#define MAX_FLOAT_PRECISION 9
+
+/* Where formatted characters go */
+typedef struct {
+    char* buf;
+    size_t limit;       /* Characters buf can hold */
+    size_t pos;         /* Characters in buf */
+    int total;          /* Characters produced, including dropped ones */
+    bool console;       /* Flush to the screen instead of truncating */
+    uint8_t color;
+} Output;
+
+/* One parsed conversion */
+typedef struct {
+    bool left;          /* '-': pad on the right */
+    bool zero;          /* '0': pad numbers with zeros */
+    int width;
+    int precision;      /* -1 if not given */
+} FormatSpec;
+
+/* ============================================================================
+ * Internal Functions
+ * ============================================================================ */
+
+static void flush(Output* out) {
+    if (out->console && out->pos > 0) {
+        screen_write_color(out->buf, out->pos, out->color);
+    }
+    out->pos = 0;
+}
+
+static void out_char(Output* out, char c) {
+    if (out->pos >= out->limit) {
+        if (!out->console) {
+            out->total++;
+            return;
+        }
+        flush(out);
+    }
+    out->buf[out->pos++] = c;
+    out->total++;
+}
+
+static void out_repeat(Output* out, char c, int count) {
+    while (count-- > 0) out_char(out, c);
+}
+
+/* Emit an optional sign and len characters of str, padded to the width */
+static void out_field(Output* out, char sign, const char* str, int len,
+                      const FormatSpec* spec) {
+    int pad = spec->width - len - (sign ? 1 : 0);
+
+    if (!spec->left && !spec->zero) out_repeat(out, ' ', pad);
+    if (sign) out_char(out, sign);
+    if (!spec->left && spec->zero) out_repeat(out, '0', pad);
+    while (len-- > 0) out_char(out, *str++);
+    if (spec->left) out_repeat(out, ' ', pad);
+}
+
+/* Write value in base into the end of tmp; returns the first digit */
+static char* format_unsigned(char* end, uint32_t value, int base, bool upper) {
+    const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char* p = end;
+    do {
+        *--p = digits[value % base];
+        value /= base;
+    } while (value);
+    return p;
+}
+
+/* Write a non-negative value with precision decimals; returns the length */
+static int format_float(char* tmp, double value, int precision) {
+    char* p = tmp;
+
+    if (value != value) {
+        memcpy(tmp, "nan", 3);
+        return 3;
+    }
+    if (value - value != 0) {
+        memcpy(tmp, "inf", 3);
+        return 3;
+    }
+
+    uint32_t scale = 1;
+    for (int i = 0; i < precision; i++) scale *= 10;
+
+    /* Too big for 32 bits: print as d.ddde+N */
+    int exponent = 0;
+    if (value >= 4294967295.0) {
+        while (value >= 10.0) {
+            value /= 10.0;
+            exponent++;
+        }
+    }
+
+    double rounded = value + 0.5 / scale;
+    uint32_t whole = (uint32_t)rounded;
+    uint32_t frac = (uint32_t)((rounded - whole) * scale);
+    if (frac >= scale) {
+        frac -= scale;
+        whole++;
+    }
+
+    char digits[12];
+    char* end = digits + sizeof(digits);
+    char* d = format_unsigned(end, whole, 10, false);
+    while (d < end) *p++ = *d++;
+
+    if (precision > 0) {
+        *p++ = '.';
+        d = format_unsigned(end, frac, 10, false);
+        for (int pad = precision - (end - d); pad > 0; pad--) *p++ = '0';
+        while (d < end) *p++ = *d++;
+    }
+
+    if (exponent) {
+        *p++ = 'e';
+        *p++ = '+';
+        d = format_unsigned(end, exponent, 10, false);
+        while (d < end) *p++ = *d++;
+    }
+    return p - tmp;
+}
+
+/* The formatter */
+static void format(Output* out, const char* fmt, va_list args) {
+    char tmp[48];
+    char* end = tmp + sizeof(tmp);
+
+    while (*fmt) {
+        if (*fmt != '%') {
+            out_char(out, *fmt++);
+            continue;
+        }
+        fmt++;
+
+        FormatSpec spec = { false, false, 0, -1 };
+
+        /* Flags */
+        for (;; fmt++) {
+            if (*fmt == '-') spec.left = true;
+            else if (*fmt == '0') spec.zero = true;
+            else break;
+        }
+
+        /* Width */
+        if (*fmt == '*') {
+            spec.width = va_arg(args, int);
+            if (spec.width < 0) {
+                spec.left = true;
+                spec.width = -spec.width;
+            }
+            fmt++;
+        } else {
+            while (*fmt >= '0' && *fmt <= '9') {
+                spec.width = spec.width * 10 + (*fmt++ - '0');
+            }
+        }
+
+        /* Precision */
+        if (*fmt == '.') {
+            fmt++;
+            spec.precision = 0;
+            if (*fmt == '*') {
+                spec.precision = va_arg(args, int);
+                fmt++;
+            } else {
+                while (*fmt >= '0' && *fmt <= '9') {
+                    spec.precision = spec.precision * 10 + (*fmt++ - '0');
+                }
+            }
+        }
+
+        /* Length modifiers: everything is 32 bits here */
+        while (*fmt == 'l' || *fmt == 'h' || *fmt == 'z') fmt++;
+
+        if (spec.left) spec.zero = false;
+
+        char* s;
+        switch (*fmt) {
+            case 'd':
+            case 'i': {
+                int value = va_arg(args, int);
+                uint32_t magnitude = value < 0 ? -(uint32_t)value : (uint32_t)value;
+                s = format_unsigned(end, magnitude, 10, false);
+                out_field(out, value < 0 ? '-' : 0, s, end - s, &spec);
+                break;
+            }
+            case 'u':
+                s = format_unsigned(end, va_arg(args, uint32_t), 10, false);
+                out_field(out, 0, s, end - s, &spec);
+                break;
+            case 'x':
+            case 'X':
+                s = format_unsigned(end, va_arg(args, uint32_t), 16, *fmt == 'X');
+                out_field(out, 0, s, end - s, &spec);
+                break;
+            case 'p': {
+                s = format_unsigned(end, (uint32_t)va_arg(args, void*), 16, false);
+                while (end - s < 8) *--s = '0';
+                *--s = 'x';
+                *--s = '0';
+                spec.zero = false;
+                out_field(out, 0, s, end - s, &spec);
+                break;
+            }
+            case 'c':
+                tmp[0] = (char)va_arg(args, int);
+                spec.zero = false;
+                out_field(out, 0, tmp, 1, &spec);
+                break;
+            case 's': {
+                const char* str = va_arg(args, const char*);
+                if (!str) str = "(null)";
+                int len = 0;
+                while (str[len] && (spec.precision < 0 || len < spec.precision)) len++;
+                spec.zero = false;
+                out_field(out, 0, str, len, &spec);
+                break;
+            }
+            case 'f': {
+                double value = va_arg(args, double);
+                int precision = spec.precision < 0 ? KPRINTF_FLOAT_PRECISION : spec.precision;
+                if (precision > MAX_FLOAT_PRECISION) precision = MAX_FLOAT_PRECISION;
+                bool negative = value < 0;
+                int len = format_float(tmp, negative ? -value : value, precision);
+                out_field(out, negative ? '-' : 0, tmp, len, &spec);
+                break;
+            }
+            case '%':
+                out_char(out, '%');
+                break;
+            case '\0':
+                return;
+            default:
+                /* Unknown conversion: print it as written */
+                out_char(out, '%');
+                out_char(out, *fmt);
+                break;
+        }
+        fmt++;
+    }
+}
+
+/* Format to the console in color */
+static int console_vprintf(uint8_t color, const char* fmt, va_list args) {
+    char buf[KPRINTF_BUFFER_SIZE];
+    Output out = { buf, sizeof(buf), 0, 0, true, color };
+
+    format(&out, fmt, args);
+    flush(&out);
+    return out.total;
+}
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================ */
+
+/*
+ * Format into buf (at most size - 1 characters plus a terminator).
+ * Returns the length the whole output would have had.
+ */
+int kvsnprintf(char* buf, size_t size, const char* fmt, va_list args) {
+    Output out = { buf, size ? size - 1 : 0, 0, 0, false, 0 };
+
+    format(&out, fmt, args);
+    if (size) buf[out.pos] = '\0';
+    return out.total;
+}
+
+int ksnprintf(char* buf, size_t size, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int len = kvsnprintf(buf, size, fmt, args);
+    va_end(args);
+    return len;
+}
+
+/* Print to the console in the default color */
+int kprintf(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int len = console_vprintf(DEFAULT_COLOR, fmt, args);
+    va_end(args);
+    return len;
+}
+
+/* Print to the console in the given color */
+int kprintf_color(uint8_t color, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int len = console_vprintf(color, fmt, args);
+    va_end(args);
+    return len;
+}
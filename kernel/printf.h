@@ -0,0 +1,32 @@
+/*
+ * ============================================================================
+ * Kernel printf Header
+ * ============================================================================
+ * Formatted output into buffers and onto the console
+ * ============================================================================
+ */
+
+#ifndef PRINTF_H
+#define PRINTF_H
+
+#include "kernel.h"
+#include <stdarg.h>
+
+/* kprintf() formats into a stack buffer of this size, flushing when full */
+#define KPRINTF_BUFFER_SIZE 256
+
+/* Default digits after the point for %f */
+#define KPRINTF_FLOAT_PRECISION 6
+
+/*
+ * Supported conversions: %d %i %u %x %X %c %s %f %p %%
+ * Flags '-' (left align) and '0' (zero pad), a field width and a
+ * precision (digits for %f, maximum characters for %s), each of which
+ * may be '*'. The 'l' length modifier is accepted and ignored.
+ */
+int kvsnprintf(char* buf, size_t size, const char* fmt, va_list args);
+int ksnprintf(char* buf, size_t size, const char* fmt, ...);
+int kprintf(const char* fmt, ...);
+int kprintf_color(uint8_t color, const char* fmt, ...);
+
+#endif /* PRINTF_H */
@@ -3,16 +3,55 @@
  * Screen Driver Implementation
  * ============================================================================
  * VGA text mode display driver
- * Writes directly to video memory at 0xB8000
+ *
+ * Text is drawn into a ring of lines in RAM, which doubles as the
+ * scrollback buffer; rows that changed are marked dirty. screen_flush()
+ * copies the dirty rows to video memory at 0xB8000 (whole rows with
+ * memcpy) and moves the hardware cursor, which costs four port writes,
+ * only if it moved. Every public print function flushes once when it is
+ * done.
+ *
+ * Scrolling is O(1): the ring just advances a line, and on the VGA side
+ * the CRTC start address moves down one row through the 32 KB text
+ * window, so only the new bottom row needs drawing. When the window runs
+ * out the display jumps back to the top of it and is redrawn once.
+ *
+ * Shift+PgUp/PgDn page through the ring (see screen_scroll_view()).
+ * Until screen_init_scrollback() allocates the full ring, a small static
+ * one is used.
+ *
+ * Output can also be mirrored to, or redirected to, the serial port
+ * (screen_set_outputs()). Serial output is queued and sent from
+ * screen_flush(), so printing never waits on the UART.
  * ============================================================================
  */
 
 #include "screen.h"
+#include "memory.h"
+#include "serial.h"
 
 /* VGA I/O Ports */
 #define VGA_CTRL_REG 0x3D4
 #define VGA_DATA_REG 0x3D5
 
+/* CRTC registers */
+#define CRTC_START_HIGH  0x0C
+#define CRTC_START_LOW   0x0D
+#define CRTC_CURSOR_HIGH 0x0E
+#define CRTC_CURSOR_LOW  0x0F
+
+#define SCREEN_CELLS (SCREEN_WIDTH * SCREEN_HEIGHT)
+#define ALL_ROWS     ((1u << SCREEN_HEIGHT) - 1)
+#define BLANK_CELL   ((DEFAULT_COLOR << 8) | ' ')
+#define LINE_BYTES   (SCREEN_WIDTH * sizeof(uint16_t))
+
+/* Text window at VIDEO_MEMORY: 32 KB, 204 whole rows */
+#define VGA_TEXT_CELLS 16384
+#define VGA_TEXT_ROWS  (VGA_TEXT_CELLS / SCREEN_WIDTH)
+
+/* Line ring used before the scrollback ring exists (a power of two) */
+#define BOOT_RING_LINES 32
+
 /* Current cursor position */
 static int cursor_row = 0;
 static int cursor_col = 0;
@@ -20,76 +59,141 @@ static int cursor_col = 0;
 /* Current color attribute */
 static uint8_t current_color = DEFAULT_COLOR;
 
+/* Where output goes (CONSOLE_* flags) */
+static uint8_t outputs = CONSOLE_VGA;
+
 /* Video memory pointer */
-static volatile uint16_t* video_memory = (volatile uint16_t*)VIDEO_MEMORY;
+static uint16_t* video_memory = (uint16_t*)VIDEO_MEMORY;
+
+/*
+ * Line ring: line n lives at ring[(n & ring_mask) * SCREEN_WIDTH]. Line
+ * numbers only grow; top_line is screen row 0 and oldest_line the oldest
+ * line still held.
+ */
+static uint16_t boot_ring[BOOT_RING_LINES * SCREEN_WIDTH];
+static uint16_t* ring = boot_ring;
+static uint32_t ring_mask = BOOT_RING_LINES - 1;
+static uint32_t top_line = 0;
+static uint32_t oldest_line = 0;
+
+/* Lines the view is scrolled back from the live screen */
+static uint32_t view_back = 0;
+
+/* Screen rows VGA memory has not seen yet */
+static uint32_t dirty_rows = 0;
+
+/* VGA row shown at the top, and what the CRTC was last told (-1: unknown) */
+static int vga_top = 0;
+static int hw_start = -1;
+static int hw_cursor = -1;
 
 /* ============================================================================
  * Internal Functions
  * ============================================================================ */
 
-/* Update hardware cursor position */
+/* Write a 16-bit value to a pair of CRTC registers */
+static void crtc_write(uint8_t high_reg, uint8_t low_reg, uint16_t value) {
+    port_byte_out(VGA_CTRL_REG, high_reg);
+    port_byte_out(VGA_DATA_REG, (value >> 8) & 0xFF);
+    port_byte_out(VGA_CTRL_REG, low_reg);
+    port_byte_out(VGA_DATA_REG, value & 0xFF);
+}
+
+/* Update display start and hardware cursor position */
 static void update_cursor(void) {
-    uint16_t pos = cursor_row * SCREEN_WIDTH + cursor_col;
+    int start = vga_top * SCREEN_WIDTH;
+    if (start != hw_start) {
+        crtc_write(CRTC_START_HIGH, CRTC_START_LOW, start);
+        hw_start = start;
+    }
     
-    port_byte_out(VGA_CTRL_REG, 14);
-    port_byte_out(VGA_DATA_REG, (pos >> 8) & 0xFF);
-    port_byte_out(VGA_CTRL_REG, 15);
-    port_byte_out(VGA_DATA_REG, pos & 0xFF);
+    /* Park the cursor below the visible rows while scrolled back */
+    int pos = start + (view_back ? SCREEN_CELLS
+                                 : cursor_row * SCREEN_WIDTH + cursor_col);
+    if (pos == hw_cursor) return;
+    
+    crtc_write(CRTC_CURSOR_HIGH, CRTC_CURSOR_LOW, pos);
+    hw_cursor = pos;
 }
 
-/* Get offset in video memory */
-static int get_offset(int row, int col) {
-    return row * SCREEN_WIDTH + col;
+/* Cells of ring line n */
+static uint16_t* line_cells(uint32_t n) {
+    return ring + (n & ring_mask) * SCREEN_WIDTH;
 }
 
-/* ============================================================================
- * Screen Functions
- * ============================================================================ */
+/* Fill ring line n with blanks */
+static void clear_line(uint32_t n) {
+    uint16_t* cells = line_cells(n);
+    for (int i = 0; i < SCREEN_WIDTH; i++) {
+        cells[i] = BLANK_CELL;
+    }
+}
 
-/* Initialize the screen */
-void screen_init(void) {
-    screen_clear();
-    cursor_row = 0;
-    cursor_col = 0;
-    update_cursor();
+/* Set one cell of the live screen */
+static void set_cell(int row, int col, uint16_t cell) {
+    line_cells(top_line + row)[col] = cell;
+    dirty_rows |= 1u << row;
 }
 
-/* Clear the entire screen */
-void screen_clear(void) {
-    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
-        video_memory[i] = (DEFAULT_COLOR << 8) | ' ';
-    }
-    cursor_row = 0;
+/* Move to the start of the next line, scrolling at the bottom */
+static void next_line(void) {
     cursor_col = 0;
-    update_cursor();
+    cursor_row++;
+    
+    if (cursor_row >= SCREEN_HEIGHT) {
+        screen_scroll();
+    }
 }
 
-/* Scroll the screen up by one line */
-void screen_scroll(void) {
-    /* Move all lines up by one */
-    for (int i = 0; i < (SCREEN_HEIGHT - 1) * SCREEN_WIDTH; i++) {
-        video_memory[i] = video_memory[i + SCREEN_WIDTH];
+/* Step back one cell and blank it */
+static void erase_char(void) {
+    if (cursor_col > 0) {
+        cursor_col--;
+    } else if (cursor_row > 0) {
+        cursor_row--;
+        cursor_col = SCREEN_WIDTH - 1;
     }
     
-    /* Clear the last line */
-    int start = (SCREEN_HEIGHT - 1) * SCREEN_WIDTH;
-    for (int i = 0; i < SCREEN_WIDTH; i++) {
-        video_memory[start + i] = (DEFAULT_COLOR << 8) | ' ';
+    set_cell(cursor_row, cursor_col, (current_color << 8) | ' ');
+}
+
+/* Queue a character for the serial console, in terminal terms */
+static void serial_echo(char c) {
+    if (c == '\n') {
+        serial_put_char('\r');
+    }
+    serial_put_char(c);
+    if (c == '\b') {
+        serial_put_char(' ');
+        serial_put_char('\b');
     }
-    
-    cursor_row = SCREEN_HEIGHT - 1;
 }
 
-/* Print a single character with color */
-void screen_put_char_color(char c, uint8_t color) {
+/*
+ * Write one character at the cursor into the line ring. Nothing reaches
+ * the hardware until screen_flush().
+ */
+static void put_char(char c, uint8_t color) {
+    if (outputs & CONSOLE_SERIAL) {
+        serial_echo(c);
+    }
+    if (!(outputs & CONSOLE_VGA)) {
+        return;
+    }
+    
+    /* New output brings a scrolled-back view home */
+    if (view_back) {
+        view_back = 0;
+        dirty_rows = ALL_ROWS;
+    }
+    
     if (c == '\n') {
-        screen_newline();
+        next_line();
         return;
     }
     
     if (c == '\r') {
         cursor_col = 0;
-        update_cursor();
         return;
     }
     
@@ -97,29 +201,154 @@ void screen_put_char_color(char c, uint8_t color) {
         /* Tab to next 4-column boundary */
         cursor_col = (cursor_col + 4) & ~3;
         if (cursor_col >= SCREEN_WIDTH) {
-            screen_newline();
+            next_line();
         }
-        update_cursor();
         return;
     }
     
     if (c == '\b') {
-        screen_backspace();
+        erase_char();
         return;
     }
     
     /* Regular character */
-    int offset = get_offset(cursor_row, cursor_col);
-    video_memory[offset] = (color << 8) | (uint8_t)c;
+    set_cell(cursor_row, cursor_col, (color << 8) | (uint8_t)c);
     
     cursor_col++;
     if (cursor_col >= SCREEN_WIDTH) {
-        screen_newline();
+        next_line();
+    }
+}
+
+/* ============================================================================
+ * Screen Functions
+ * ============================================================================ */
+
+/* Initialize the screen */
+void screen_init(void) {
+    ring = boot_ring;
+    ring_mask = BOOT_RING_LINES - 1;
+    top_line = 0;
+    oldest_line = 0;
+    view_back = 0;
+    vga_top = 0;
+    hw_start = -1;
+    hw_cursor = -1;
+    outputs = CONSOLE_VGA | (serial_present() ? CONSOLE_SERIAL : 0);
+    screen_clear();
+}
+
+/* Choose where output goes (CONSOLE_* flags; serial only if present) */
+void screen_set_outputs(uint8_t which) {
+    if (!serial_present()) {
+        which &= ~CONSOLE_SERIAL;
+    }
+    if (!which) return;
+    
+    /* VGA missed everything while it was off */
+    if ((which & CONSOLE_VGA) && !(outputs & CONSOLE_VGA)) {
+        dirty_rows = ALL_ROWS;
+    }
+    outputs = which;
+    screen_flush();
+}
+
+uint8_t screen_get_outputs(void) {
+    return outputs;
+}
+
+/* Move the screen into a SCROLLBACK_LINES ring (needs the heap) */
+void screen_init_scrollback(void) {
+    uint16_t* big = (uint16_t*)malloc(SCROLLBACK_LINES * LINE_BYTES);
+    if (!big) return;
+    
+    uint16_t* old_ring = ring;
+    uint32_t old_mask = ring_mask;
+    for (uint32_t n = oldest_line; n != top_line + SCREEN_HEIGHT; n++) {
+        memcpy(big + (n & (SCROLLBACK_LINES - 1)) * SCREEN_WIDTH,
+               old_ring + (n & old_mask) * SCREEN_WIDTH, LINE_BYTES);
+    }
+    
+    ring = big;
+    ring_mask = SCROLLBACK_LINES - 1;
+    if (old_ring != boot_ring) free(old_ring);
+}
+
+/* Copy dirty rows to video memory, update the CRTC and kick the UART */
+void screen_flush(void) {
+    if (outputs & CONSOLE_SERIAL) {
+        serial_poll();
+    }
+    if (!(outputs & CONSOLE_VGA)) {
+        return;
     }
     
+    uint32_t first = top_line - view_back;
+    uint16_t* vga = video_memory + vga_top * SCREEN_WIDTH;
+    
+    for (int row = 0; dirty_rows >> row; row++) {
+        if (dirty_rows & (1u << row)) {
+            memcpy(vga + row * SCREEN_WIDTH, line_cells(first + row), LINE_BYTES);
+        }
+    }
+    dirty_rows = 0;
+    
     update_cursor();
 }
 
+/* Clear the entire screen (the scrollback keeps its lines) */
+void screen_clear(void) {
+    for (int row = 0; row < SCREEN_HEIGHT; row++) {
+        clear_line(top_line + row);
+    }
+    view_back = 0;
+    dirty_rows = ALL_ROWS;
+    cursor_row = 0;
+    cursor_col = 0;
+    screen_flush();
+}
+
+/* Scroll the screen up by one line */
+void screen_scroll(void) {
+    /* Advance the ring; the line falling off the top becomes history */
+    top_line++;
+    clear_line(top_line + SCREEN_HEIGHT - 1);
+    if (top_line + SCREEN_HEIGHT - oldest_line > ring_mask + 1) {
+        oldest_line = top_line + SCREEN_HEIGHT - (ring_mask + 1);
+    }
+    
+    /* Follow with the display start; redraw only when the window wraps */
+    if (vga_top + SCREEN_HEIGHT < VGA_TEXT_ROWS) {
+        vga_top++;
+        dirty_rows = (dirty_rows >> 1) | (1u << (SCREEN_HEIGHT - 1));
+    } else {
+        vga_top = 0;
+        dirty_rows = ALL_ROWS;
+    }
+    
+    cursor_row = SCREEN_HEIGHT - 1;
+}
+
+/* Scroll the view back (lines > 0) or forward through the scrollback */
+void screen_scroll_view(int lines) {
+    int back = (int)view_back + lines;
+    int max_back = top_line - oldest_line;
+    
+    if (back < 0) back = 0;
+    if (back > max_back) back = max_back;
+    if ((uint32_t)back == view_back) return;
+    
+    view_back = back;
+    dirty_rows = ALL_ROWS;
+    screen_flush();
+}
+
+/* Print a single character with color */
+void screen_put_char_color(char c, uint8_t color) {
+    put_char(c, color);
+    screen_flush();
+}
+
 /* Print a single character with default color */
 void screen_put_char(char c) {
     screen_put_char_color(c, current_color);
@@ -127,35 +356,35 @@ void screen_put_char(char c) {
 
 /* Handle newline */
 void screen_newline(void) {
-    cursor_col = 0;
-    cursor_row++;
-    
-    if (cursor_row >= SCREEN_HEIGHT) {
-        screen_scroll();
-    }
-    
-    update_cursor();
+    put_char('\n', current_color);
+    screen_flush();
 }
 
 /* Handle backspace */
 void screen_backspace(void) {
-    if (cursor_col > 0) {
-        cursor_col--;
-    } else if (cursor_row > 0) {
-        cursor_row--;
-        cursor_col = SCREEN_WIDTH - 1;
+    put_char('\b', current_color);
+    screen_flush();
+}
+
+/* Print len characters with color, flushing once at the end */
+void screen_write_color(const char* str, size_t len, uint8_t color) {
+    while (len--) {
+        put_char(*str++, color);
     }
-    
-    int offset = get_offset(cursor_row, cursor_col);
-    video_memory[offset] = (current_color << 8) | ' ';
-    update_cursor();
+    screen_flush();
+}
+
+/* Print len characters with default color */
+void screen_write(const char* str, size_t len) {
+    screen_write_color(str, len, current_color);
 }
 
 /* Print a string with color */
 void screen_print_color(const char* str, uint8_t color) {
     while (*str) {
-        screen_put_char_color(*str++, color);
+        put_char(*str++, color);
     }
+    screen_flush();
 }
 
 /* Print a string with default color */
@@ -165,8 +394,11 @@ void screen_print(const char* str) {
 
 /* Print a string followed by newline */
 void screen_print_line(const char* str) {
-    screen_print(str);
-    screen_newline();
+    while (*str) {
+        put_char(*str++, current_color);
+    }
+    put_char('\n', current_color);
+    screen_flush();
 }
 
 /* Print an integer */
@@ -2,7 +2,8 @@
  * ============================================================================
  * Screen Driver Header
  * ============================================================================
- * VGA text mode display functions
+ * VGA text mode display functions (with hardware scrolling and scrollback),
+ * optionally mirrored to the serial port
  * ============================================================================
  */
 
@@ -16,6 +17,13 @@
 #define SCREEN_WIDTH 80
 #define SCREEN_HEIGHT 25
 
+/* Lines kept for Shift+PgUp (a power of two; 160 bytes each) */
+#define SCROLLBACK_LINES 4096
+
+/* Console outputs */
+#define CONSOLE_VGA    0x01
+#define CONSOLE_SERIAL 0x02
+
 /* Color Attributes */
 #define COLOR_BLACK         0x0
 #define COLOR_BLUE          0x1
@@ -46,17 +54,24 @@
 
 /* Screen Functions */
 void screen_init(void);
+void screen_init_scrollback(void);
 void screen_clear(void);
 void screen_put_char(char c);
 void screen_put_char_color(char c, uint8_t color);
 void screen_print(const char* str);
 void screen_print_color(const char* str, uint8_t color);
+void screen_write(const char* str, size_t len);
+void screen_write_color(const char* str, size_t len, uint8_t color);
 void screen_print_line(const char* str);
 void screen_print_int(int value);
 void screen_set_cursor(int row, int col);
 void screen_get_cursor(int* row, int* col);
 void screen_scroll(void);
+void screen_flush(void);
+void screen_scroll_view(int lines);
 void screen_backspace(void);
 void screen_newline(void);
+void screen_set_outputs(uint8_t which);
+uint8_t screen_get_outputs(void);
 
 #endif /* SCREEN_H */
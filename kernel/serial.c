@@ -0,0 +1,219 @@
+/*
+ * ============================================================================
+ * Serial Port Driver Implementation
+ * ============================================================================
+ * COM1 at 115200 8N1 with the 16550 FIFO enabled.
+ *
+ * Output is queued in a ring buffer and never waits on the line. Each
+ * time the transmit FIFO runs empty, up to a full FIFO (16 bytes) is
+ * moved into it: from the IRQ 4 handler once interrupts are on, or by
+ * serial_poll(), which the console calls after every write. Only when
+ * the ring is full does a writer wait for the UART to catch up.
+ *
+ * Received bytes are collected by the IRQ handler into a second ring.
+ *
+ * Reference: https://wiki.osdev.org/Serial_Ports
+ * ============================================================================
+ */
+
+#include "serial.h"
+#include "interrupt.h"
+#include "printf.h"
+#include "screen.h"
+
+#define TX_MASK (SERIAL_TX_BUFFER_SIZE - 1)
+#define RX_MASK (SERIAL_RX_BUFFER_SIZE - 1)
+
+/* Interrupt enable: received data, transmit FIFO empty */
+#define IER_RX_AVAILABLE 0x01
+#define IER_THR_EMPTY    0x02
+
+/* Line control: 8 data bits, no parity, 1 stop bit; DLAB selects the divisor */
+#define LCR_8N1  0x03
+#define LCR_DLAB 0x80
+
+/* FIFO control: enable, clear both FIFOs, interrupt at 14 bytes */
+#define FCR_ENABLE_CLEAR_14 0xC7
+
+/* Modem control: DTR, RTS, OUT2; LOOP echoes output back for the self-test */
+#define MCR_NORMAL   0x0B
+#define MCR_LOOPBACK 0x1E
+
+/* IIR bits 6-7 read 11 once a 16550A has its FIFOs enabled */
+#define IIR_FIFO_ENABLED 0xC0
+
+#define UART_CLOCK 115200
+#define UART_FIFO_SIZE 16
+
+static bool present = false;
+static int fifo_size = 1;
+
+/* Transmit ring: head is where the next byte goes, tail the next to send */
+static char tx_buffer[SERIAL_TX_BUFFER_SIZE];
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+
+/* Receive ring: filled by the IRQ handler, emptied by serial_read_char() */
+static volatile char rx_buffer[SERIAL_RX_BUFFER_SIZE];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+
+/* Bytes handed to the UART, and times a writer had to wait for it */
+static uint32_t tx_bytes = 0;
+static uint32_t tx_stalls = 0;
+
+/* ============================================================================
+ * Internal Functions
+ * ============================================================================ */
+
+static void uart_write(int reg, uint8_t value) {
+    port_byte_out(SERIAL_COM1 + reg, value);
+}
+
+static uint8_t uart_read(int reg) {
+    return port_byte_in(SERIAL_COM1 + reg);
+}
+
+/* Move queued bytes into the transmit FIFO (caller checked it is empty) */
+static void tx_refill(void) {
+    for (int i = 0; i < fifo_size && tx_tail != tx_head; i++) {
+        uart_write(SERIAL_DATA, tx_buffer[tx_tail & TX_MASK]);
+        tx_tail++;
+        tx_bytes++;
+    }
+}
+
+/* IRQ 4: collect received bytes, keep the transmitter busy */
+static void serial_irq(InterruptFrame* frame) {
+    (void)frame;
+
+    uint8_t status;
+    while ((status = uart_read(SERIAL_LINE_STATUS)) & SERIAL_LSR_DATA_READY) {
+        char c = uart_read(SERIAL_DATA);
+        if (rx_head - rx_tail < SERIAL_RX_BUFFER_SIZE) {
+            rx_buffer[rx_head & RX_MASK] = c;
+            rx_head++;
+        }
+    }
+
+    if (status & SERIAL_LSR_THR_EMPTY) {
+        tx_refill();
+    }
+    if (tx_head == tx_tail) {
+        uart_write(SERIAL_INT_ENABLE, IER_RX_AVAILABLE);
+    }
+}
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================ */
+
+/* Program COM1 and check that something answers. Returns true if it does. */
+bool serial_init(void) {
+    uint16_t divisor = UART_CLOCK / SERIAL_BAUD;
+
+    present = false;
+    fifo_size = 1;
+    tx_head = 0;
+    tx_tail = 0;
+    rx_head = 0;
+    rx_tail = 0;
+    tx_bytes = 0;
+    tx_stalls = 0;
+
+    uart_write(SERIAL_INT_ENABLE, 0x00);
+    uart_write(SERIAL_LINE_CTRL, LCR_DLAB);
+    uart_write(SERIAL_DATA, divisor & 0xFF);
+    uart_write(SERIAL_INT_ENABLE, divisor >> 8);
+    uart_write(SERIAL_LINE_CTRL, LCR_8N1);
+    uart_write(SERIAL_FIFO_CTRL, FCR_ENABLE_CLEAR_14);
+
+    /* Loopback self-test: an absent port reads back 0xFF */
+    uart_write(SERIAL_MODEM_CTRL, MCR_LOOPBACK);
+    uart_write(SERIAL_DATA, 0xAE);
+    if (uart_read(SERIAL_DATA) != 0xAE) {
+        return false;
+    }
+    uart_write(SERIAL_MODEM_CTRL, MCR_NORMAL);
+
+    if ((uart_read(SERIAL_FIFO_CTRL) & IIR_FIFO_ENABLED) == IIR_FIFO_ENABLED) {
+        fifo_size = UART_FIFO_SIZE;
+    }
+    present = true;
+
+    irq_register(IRQ_COM1, serial_irq);
+    uart_write(SERIAL_INT_ENABLE, IER_RX_AVAILABLE);
+    return true;
+}
+
+bool serial_present(void) {
+    return present;
+}
+
+/* Queue one byte, waiting only if the ring is full */
+void serial_put_char(char c) {
+    if (!present) return;
+
+    if (tx_head - tx_tail == SERIAL_TX_BUFFER_SIZE) {
+        tx_stalls++;
+        while (tx_head - tx_tail == SERIAL_TX_BUFFER_SIZE) {
+            serial_poll();
+        }
+    }
+    tx_buffer[tx_head & TX_MASK] = c;
+    tx_head++;
+}
+
+/* Queue len bytes and start sending them */
+void serial_write(const char* data, size_t len) {
+    while (len--) {
+        serial_put_char(*data++);
+    }
+    serial_poll();
+}
+
+/*
+ * Refill the transmit FIFO if it has drained, and have the UART interrupt
+ * when it drains again while bytes are still queued
+ */
+void serial_poll(void) {
+    if (!present || tx_head == tx_tail) return;
+
+    uint32_t flags = irq_save();
+    if (uart_read(SERIAL_LINE_STATUS) & SERIAL_LSR_THR_EMPTY) {
+        tx_refill();
+    }
+    if (tx_head != tx_tail) {
+        uart_write(SERIAL_INT_ENABLE, IER_RX_AVAILABLE | IER_THR_EMPTY);
+    }
+    irq_restore(flags);
+}
+
+/* Wait until everything queued has been handed to the UART */
+void serial_flush(void) {
+    while (present && tx_head != tx_tail) {
+        serial_poll();
+    }
+}
+
+/* Read a received byte (non-blocking, returns 0 if none) */
+char serial_read_char(void) {
+    if (rx_tail == rx_head) {
+        return 0;
+    }
+    char c = rx_buffer[rx_tail & RX_MASK];
+    rx_tail++;
+    return c;
+}
+
+/* Print port settings and transmit counters */
+void serial_dump(void) {
+    screen_print_color("\n=== Serial ===\n", INFO_COLOR);
+    if (!present) {
+        screen_print("COM1: not present\n");
+        return;
+    }
+    kprintf("COM1:     %u baud 8N1, %d-byte FIFO\n", SERIAL_BAUD, fifo_size);
+    kprintf("Sent:     %u bytes, %u queued, %u writer stalls\n",
+            tx_bytes, tx_head - tx_tail, tx_stalls);
+}
@@ -0,0 +1,45 @@
+/*
+ * ============================================================================
+ * Serial Port Driver Header
+ * ============================================================================
+ * 16550 UART on COM1, used as a second console for headless runs
+ * (qemu -nographic / -serial stdio)
+ * ============================================================================
+ */
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include "kernel.h"
+
+/* UART registers, relative to the base port */
+#define SERIAL_COM1              0x3F8
+#define SERIAL_DATA              0       /* RBR / THR (DLL with DLAB) */
+#define SERIAL_INT_ENABLE        1       /* IER (DLM with DLAB) */
+#define SERIAL_FIFO_CTRL         2       /* FCR (write) / IIR (read) */
+#define SERIAL_LINE_CTRL         3       /* LCR */
+#define SERIAL_MODEM_CTRL        4       /* MCR */
+#define SERIAL_LINE_STATUS       5       /* LSR */
+
+/* Line status bits */
+#define SERIAL_LSR_DATA_READY    0x01
+#define SERIAL_LSR_THR_EMPTY     0x20    /* Transmit FIFO empty */
+
+/* Line speed */
+#define SERIAL_BAUD              115200
+
+/* Bytes queued for transmission and reception (powers of two) */
+#define SERIAL_TX_BUFFER_SIZE    4096
+#define SERIAL_RX_BUFFER_SIZE    256
+
+/* Functions */
+bool serial_init(void);
+bool serial_present(void);
+void serial_put_char(char c);
+void serial_write(const char* data, size_t len);
+void serial_poll(void);
+void serial_flush(void);
+char serial_read_char(void);
+void serial_dump(void);
+
+#endif /* SERIAL_H */
@@ -7,11 +7,29 @@
 #include "keyboard.h"
 #include "filesystem.h"
 #include "memory.h"
+#include "memmap.h"
+#include "buddy.h"
+#include "paging.h"
+#include "cpu.h"
+#include "interrupt.h"
+#include "timer.h"
+#include "printf.h"
+#include "slab.h"
+#include "arena.h"
 #include "math.h"
 #include "ata.h"
+#include "bcache.h"
+#include "pci.h"
+#include "serial.h"
 
 static char command_buffer[MAX_COMMAND_LENGTH];
 
+/* Object cache for sector-sized scratch buffers */
+static SlabCache* sector_cache = NULL;
+
+/* Scratch arena, reset after every command */
+static Arena* cmd_arena = NULL;
+
 /* Skip whitespace and return pointer to next word */
 static char* skip_spaces(char* str) {
     while (*str == ' ' || *str == '\t') str++;
@@ -38,8 +56,18 @@ static void cmd_help(void) {
     screen_print("  clear             - Clear the screen\n");
     screen_print("  about             - About MyOS\n");
     screen_print("  mem               - Show memory status\n");
+    screen_print("  memmap            - Show physical memory map and paging\n");
     screen_print("  math              - Test math library\n");
     screen_print("  disk              - Test disk reading\n");
+    screen_print("  membench          - Benchmark memcpy/memset/strlen\n");
+    screen_print("  diskbench         - Benchmark ATA sector reads\n");
+    screen_print("  sync              - Flush the disk write cache\n");
+    screen_print("  bcache            - Show block cache hit rate\n");
+    screen_print("  cpu               - Show CPU features\n");
+    screen_print("  irq               - Show interrupt counts\n");
+    screen_print("  pci               - List PCI devices\n");
+    screen_print("  uptime            - Show uptime and timer rates\n");
+    screen_print("  console [out]     - Output to vga, serial or both\n");
     screen_print("  list              - List all files\n");
     screen_print("  create <file>     - Create a new file\n");
     screen_print("  read <file>       - Read file contents\n");
@@ -55,34 +83,26 @@ static void cmd_about(void) {
 
 static void cmd_mem(void) {
     memory_dump();
+    cache_dump();
+    buddy_dump();
 }
 
-/* Helper to print float (simple version) */
-static void print_float(float f) {
-    char buf[16];
-    if (f < 0) { screen_print("-"); f = -f; }
-    int whole = (int)f;
-    int frac = (int)((f - whole) * 1000);
-    itoa(whole, buf, 10);
-    screen_print(buf);
-    screen_print(".");
-    if (frac < 100) screen_print("0");
-    if (frac < 10) screen_print("0");
-    itoa(frac, buf, 10);
-    screen_print(buf);
+static void cmd_memmap(void) {
+    memmap_dump();
+    paging_dump();
 }
 
 static void cmd_math(void) {
     screen_print_color("\n=== Math Library Test ===\n", HIGHLIGHT_COLOR);
     
-    screen_print("expf(1.0) = "); print_float(expf(1.0f)); screen_print(" (expect 2.718)\n");
-    screen_print("expf(0.0) = "); print_float(expf(0.0f)); screen_print(" (expect 1.000)\n");
-    screen_print("logf(2.718) = "); print_float(logf(2.718f)); screen_print(" (expect 1.000)\n");
-    screen_print("sqrtf(4.0) = "); print_float(sqrtf(4.0f)); screen_print(" (expect 2.000)\n");
-    screen_print("sqrtf(2.0) = "); print_float(sqrtf(2.0f)); screen_print(" (expect 1.414)\n");
-    screen_print("powf(2,10) = "); print_float(powf(2.0f, 10.0f)); screen_print(" (expect 1024)\n");
-    screen_print("tanhf(0.0) = "); print_float(tanhf(0.0f)); screen_print(" (expect 0.000)\n");
-    screen_print("tanhf(1.0) = "); print_float(tanhf(1.0f)); screen_print(" (expect 0.761)\n");
+    kprintf("expf(1.0) = %.3f (expect 2.718)\n", expf(1.0f));
+    kprintf("expf(0.0) = %.3f (expect 1.000)\n", expf(0.0f));
+    kprintf("logf(2.718) = %.3f (expect 1.000)\n", logf(2.718f));
+    kprintf("sqrtf(4.0) = %.3f (expect 2.000)\n", sqrtf(4.0f));
+    kprintf("sqrtf(2.0) = %.3f (expect 1.414)\n", sqrtf(2.0f));
+    kprintf("powf(2,10) = %.3f (expect 1024)\n", powf(2.0f, 10.0f));
+    kprintf("tanhf(0.0) = %.3f (expect 0.000)\n", tanhf(0.0f));
+    kprintf("tanhf(1.0) = %.3f (expect 0.761)\n", tanhf(1.0f));
     
     screen_print_color("\nMath library ready for LLM inference!\n\n", INFO_COLOR);
 }
@@ -90,26 +110,25 @@ static void cmd_math(void) {
 static void cmd_disk(void) {
     screen_print_color("\n=== ATA Disk Test ===\n", HIGHLIGHT_COLOR);
     
-    uint8_t* buffer = (uint8_t*)malloc(512);
+    uint8_t* buffer = (uint8_t*)cache_alloc(sector_cache);
     if (!buffer) {
         screen_print_color("Error: Could not allocate buffer\n", ERROR_COLOR);
         return;
     }
     
+    ata_dump();
     screen_print("Reading sector 0 (bootloader)...\n");
-    int result = ata_read_sectors(0, 1, buffer);
     
-    if (result == ATA_SUCCESS) {
+    /* Copy it out so the cached sector is not pinned while we print */
+    BlockBuffer* block = bcache_get(0);
+    if (block) {
+        memcpy(buffer, block->data, ATA_SECTOR_SIZE);
+        bcache_release(block);
+        
         screen_print_color("Success! ", INFO_COLOR);
         screen_print("First 16 bytes: ");
-        char hex[4];
         for (int i = 0; i < 16; i++) {
-            uint8_t b = buffer[i];
-            hex[0] = "0123456789ABCDEF"[b >> 4];
-            hex[1] = "0123456789ABCDEF"[b & 0xF];
-            hex[2] = ' ';
-            hex[3] = 0;
-            screen_print(hex);
+            kprintf("%02X ", buffer[i]);
         }
         screen_print("\n");
         
@@ -121,10 +140,44 @@ static void cmd_disk(void) {
         screen_print_color("Error reading disk!\n", ERROR_COLOR);
     }
     
-    free(buffer);
+    cache_free(sector_cache, buffer);
     screen_print("\n");
 }
 
+static void cmd_console(char* args) {
+    char* which;
+    get_word(args, &which);
+    
+    if (which) {
+        uint8_t outputs;
+        if (strcmp(which, "vga") == 0) outputs = CONSOLE_VGA;
+        else if (strcmp(which, "serial") == 0) outputs = CONSOLE_SERIAL;
+        else if (strcmp(which, "both") == 0) outputs = CONSOLE_VGA | CONSOLE_SERIAL;
+        else {
+            screen_print_color("Usage: console [vga|serial|both]\n", ERROR_COLOR);
+            return;
+        }
+        if ((outputs & CONSOLE_SERIAL) && !serial_present()) {
+            screen_print_color("No serial port\n", ERROR_COLOR);
+            return;
+        }
+        screen_set_outputs(outputs);
+    }
+    
+    uint8_t outputs = screen_get_outputs();
+    kprintf("Console: %s%s%s\n",
+            (outputs & CONSOLE_VGA) ? "vga" : "",
+            outputs == (CONSOLE_VGA | CONSOLE_SERIAL) ? " + " : "",
+            (outputs & CONSOLE_SERIAL) ? "serial" : "");
+    serial_dump();
+}
+
+static void cmd_sync(void) {
+    if (ata_flush() != ATA_SUCCESS) {
+        screen_print_color("Error flushing disk cache!\n", ERROR_COLOR);
+    }
+}
+
 static void cmd_clear(void) {
     screen_clear();
 }
@@ -166,8 +219,12 @@ static void cmd_read(char* args) {
         screen_print_color("Usage: read <filename>\n", ERROR_COLOR);
         return;
     }
-    char buffer[MAX_FILE_SIZE];
-    int result = fs_read(filename, buffer, sizeof(buffer));
+    char* buffer = (char*)arena_alloc(cmd_arena, MAX_FILE_SIZE);
+    if (!buffer) {
+        screen_print_color("Error: Out of memory\n", ERROR_COLOR);
+        return;
+    }
+    int result = fs_read(filename, buffer, MAX_FILE_SIZE);
     if (result >= 0) {
         screen_print_color("\n--- ", INFO_COLOR);
         screen_print(filename);
@@ -224,6 +281,8 @@ static void cmd_delete(char* args) {
 /* Initialize shell */
 void shell_init(void) {
     memset(command_buffer, 0, sizeof(command_buffer));
+    sector_cache = cache_create(ATA_SECTOR_SIZE, 16);
+    cmd_arena = arena_create(SHELL_ARENA_SIZE);
 }
 
 /* Print prompt */
@@ -242,10 +301,23 @@ void shell_execute(const char* input) {
     
     if (!cmd || !*cmd) return;
     
+    /* Everything a handler takes from the arena dies with the command */
+    ArenaMark mark = arena_mark(cmd_arena);
+    
     if (strcmp(cmd, "help") == 0) cmd_help();
     else if (strcmp(cmd, "clear") == 0) cmd_clear();
     else if (strcmp(cmd, "about") == 0) cmd_about();
     else if (strcmp(cmd, "mem") == 0) cmd_mem();
+    else if (strcmp(cmd, "memmap") == 0) cmd_memmap();
+    else if (strcmp(cmd, "membench") == 0) string_benchmark();
+    else if (strcmp(cmd, "diskbench") == 0) ata_benchmark();
+    else if (strcmp(cmd, "sync") == 0) cmd_sync();
+    else if (strcmp(cmd, "bcache") == 0) bcache_dump();
+    else if (strcmp(cmd, "cpu") == 0) cpu_dump();
+    else if (strcmp(cmd, "irq") == 0) interrupt_dump();
+    else if (strcmp(cmd, "pci") == 0) pci_dump();
+    else if (strcmp(cmd, "uptime") == 0) timer_dump();
+    else if (strcmp(cmd, "console") == 0) cmd_console(rest);
     else if (strcmp(cmd, "math") == 0) cmd_math();
     else if (strcmp(cmd, "disk") == 0) cmd_disk();
     else if (strcmp(cmd, "list") == 0) cmd_list();
@@ -258,6 +330,8 @@ void shell_execute(const char* input) {
         screen_print(cmd);
         screen_print("\nType 'help' for commands.\n");
     }
+    
+    arena_reset(cmd_arena, mark);
 }
 
 /* Main shell loop */
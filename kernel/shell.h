@@ -9,6 +9,7 @@
 
 #define MAX_COMMAND_LENGTH 256
 #define MAX_ARGS 10
+#define SHELL_ARENA_SIZE (64 * 1024)  /* Per-command scratch arena chunk */
 
 void shell_init(void);
 void shell_run(void);
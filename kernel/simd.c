@@ -0,0 +1,43 @@
+/*
+ * ============================================================================
+ * SSE Kernels
+ * ============================================================================
+ * Packed-float versions of the vector kernels in math.c.
+ *
+ * This file alone is compiled with -msse -msse2 -mfpmath=sse, so the
+ * compiler may use SSE anywhere in it. Nothing here may be called unless
+ * cpu_init() selected it, i.e. the CPU has SSE2 and it is enabled.
+ * -mstackrealign keeps spills safe on our 4-byte aligned stack.
+ * ============================================================================
+ */
+
+#include "math.h"
+
+/* Four floats, loadable from any 4-byte aligned address */
+typedef float v4sf __attribute__((vector_size(16), aligned(4)));
+
+/* Dot product, 8 floats per step in two independent accumulators */
+float vec_dot_sse(const float* a, const float* b, int n) {
+    v4sf acc0 = { 0.0f, 0.0f, 0.0f, 0.0f };
+    v4sf acc1 = acc0;
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        acc0 += *(const v4sf*)(a + i) * *(const v4sf*)(b + i);
+        acc1 += *(const v4sf*)(a + i + 4) * *(const v4sf*)(b + i + 4);
+    }
+
+    acc0 += acc1;
+    float sum = (acc0[0] + acc0[1]) + (acc0[2] + acc0[3]);
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+/* out[d] = w[d][n] * x[n], one dot product per row */
+void matmul_sse(float* out, const float* x, const float* w, int n, int d) {
+    for (int i = 0; i < d; i++) {
+        out[i] = vec_dot_sse(w + i * n, x, n);
+    }
+}
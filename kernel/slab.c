@@ -0,0 +1,165 @@
+/*
+ * ============================================================================
+ * Slab Cache Implementation
+ * ============================================================================
+ * Fixed-size object caches for MyOS.
+ *
+ * Each cache takes slabs (large chunks) from malloc() and cuts them into
+ * equal objects. Free objects sit on a per-cache singly linked list, so
+ * cache_alloc() and cache_free() are a pointer pop/push with no header
+ * search and no fragmentation of the general heap.
+ * ============================================================================
+ */
+
+#include "slab.h"
+#include "memory.h"
+#include "printf.h"
+#include "screen.h"
+
+/* All live caches, for cache_dump() */
+static SlabCache *cache_list = NULL;
+
+/* ============================================================================
+ * Internal Functions
+ * ============================================================================
+ */
+
+/* Round value up to a power-of-two alignment */
+static uint32_t align_up(uint32_t value, size_t align) {
+  return (value + align - 1) & ~(align - 1);
+}
+
+/* Allocate one more slab and thread its objects onto the free list */
+static bool cache_grow(SlabCache *cache) {
+  Slab *slab = (Slab *)malloc(cache->slab_bytes);
+  if (!slab)
+    return false;
+
+  slab->next = cache->slabs;
+  cache->slabs = slab;
+  cache->num_slabs++;
+
+  uint8_t *obj =
+      (uint8_t *)align_up((uint32_t)slab + sizeof(Slab), cache->align);
+  for (uint32_t i = 0; i < cache->objs_per_slab; i++) {
+    *(void **)obj = cache->free_list;
+    cache->free_list = obj;
+    obj += cache->obj_size;
+  }
+
+  return true;
+}
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================
+ */
+
+/* Create a cache of objects of the given size and alignment */
+SlabCache *cache_create(size_t size, size_t align) {
+  if (size == 0)
+    return NULL;
+  if (align < BLOCK_ALIGN)
+    align = BLOCK_ALIGN;
+  if (align & (align - 1))
+    return NULL; /* Alignment must be a power of two */
+
+  SlabCache *cache = (SlabCache *)malloc(sizeof(SlabCache));
+  if (!cache)
+    return NULL;
+  memset(cache, 0, sizeof(SlabCache));
+
+  /* Free objects store the list link in their first word */
+  if (size < sizeof(void *))
+    size = sizeof(void *);
+
+  cache->obj_size = align_up(size, align);
+  cache->align = align;
+
+  /* malloc() only guarantees BLOCK_ALIGN, so leave room to align objects */
+  size_t overhead = align_up(sizeof(Slab), BLOCK_ALIGN) + align - BLOCK_ALIGN;
+  cache->slab_bytes = SLAB_SIZE;
+  if (cache->slab_bytes < overhead + cache->obj_size * SLAB_MIN_OBJECTS) {
+    cache->slab_bytes = overhead + cache->obj_size * SLAB_MIN_OBJECTS;
+  }
+  cache->objs_per_slab = (cache->slab_bytes - overhead) / cache->obj_size;
+
+  cache->next = cache_list;
+  cache_list = cache;
+
+  return cache;
+}
+
+/* Destroy a cache and give all of its slabs back to the heap */
+void cache_destroy(SlabCache *cache) {
+  if (!cache)
+    return;
+
+  Slab *slab = cache->slabs;
+  while (slab) {
+    Slab *next = slab->next;
+    free(slab);
+    slab = next;
+  }
+
+  SlabCache **link = &cache_list;
+  while (*link && *link != cache) {
+    link = &(*link)->next;
+  }
+  if (*link) {
+    *link = cache->next;
+  }
+
+  free(cache);
+}
+
+/* Allocate one object */
+void *cache_alloc(SlabCache *cache) {
+  if (!cache)
+    return NULL;
+
+  if (!cache->free_list && !cache_grow(cache)) {
+    return NULL;
+  }
+
+  void *obj = cache->free_list;
+  cache->free_list = *(void **)obj;
+  cache->objs_in_use++;
+  cache->num_allocs++;
+
+  return obj;
+}
+
+/* Return an object to its cache */
+void cache_free(SlabCache *cache, void *obj) {
+  if (!cache || !obj)
+    return;
+
+  if (cache->objs_in_use == 0) {
+    screen_print_color("ERROR: cache_free() on empty cache!\n", ERROR_COLOR);
+    return;
+  }
+
+  *(void **)obj = cache->free_list;
+  cache->free_list = obj;
+  cache->objs_in_use--;
+}
+
+/* Print statistics for every cache */
+void cache_dump(void) {
+  screen_print_color("=== Slab Caches ===\n", INFO_COLOR);
+
+  if (!cache_list) {
+    screen_print("  (none)\n\n");
+    return;
+  }
+
+  for (SlabCache *cache = cache_list; cache; cache = cache->next) {
+    kprintf("  %uB objs: %u/%u in use, %u slabs, %u allocs\n",
+            cache->obj_size, cache->objs_in_use,
+            cache->num_slabs * cache->objs_per_slab, cache->num_slabs,
+            cache->num_allocs);
+  }
+
+  screen_print("\n");
+}
@@ -0,0 +1,48 @@
+/*
+ * ============================================================================
+ * Slab Cache Header
+ * ============================================================================
+ * Object caches for fixed-size kernel objects, carved from the heap
+ * ============================================================================
+ */
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "kernel.h"
+
+/* Slab configuration */
+#define SLAB_SIZE 4096       /* Default bytes per slab */
+#define SLAB_MIN_OBJECTS 8   /* Grow slabs so each holds at least this many */
+
+/* One slab: a heap chunk holding objs_per_slab objects after this header */
+typedef struct Slab {
+  struct Slab *next; /* Next slab of the same cache */
+} Slab;
+
+/* An object cache */
+typedef struct SlabCache {
+  size_t obj_size;          /* Object size (rounded up to align) */
+  size_t align;             /* Object alignment (power of two) */
+  size_t slab_bytes;        /* Bytes requested from malloc() per slab */
+  uint32_t objs_per_slab;   /* Objects carved out of each slab */
+  void *free_list;          /* Free objects, linked through their first word */
+  Slab *slabs;              /* All slabs owned by this cache */
+  struct SlabCache *next;   /* Next cache in the global cache list */
+
+  /* Statistics */
+  uint32_t num_slabs;
+  uint32_t objs_in_use;
+  uint32_t num_allocs;
+} SlabCache;
+
+/* Slab cache functions */
+SlabCache *cache_create(size_t size, size_t align);
+void cache_destroy(SlabCache *cache);
+void *cache_alloc(SlabCache *cache);
+void cache_free(SlabCache *cache, void *obj);
+
+/* Debug functions */
+void cache_dump(void);
+
+#endif /* SLAB_H */
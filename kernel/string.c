@@ -0,0 +1,484 @@
+/*
+ * ============================================================================
+ * Memory and String Routines
+ * ============================================================================
+ * memcpy, memset, memmove, strlen and strcmp, tuned by size:
+ *
+ * - Below MEM_SSE_MIN bytes (or without SSE2): rep movsd / rep stosd,
+ *   with rep movsb / stosb for the last 0-3 bytes.
+ * - From MEM_SSE_MIN bytes: align the destination to 16 bytes, then move
+ *   64 bytes per loop with SSE2 unaligned loads and aligned stores.
+ * - From MEM_NT_MIN bytes: the same loop with non-temporal stores, so a
+ *   big copy does not push everything else out of the cache.
+ * - memmove copies backwards when the destination overlaps the source
+ *   from above, and otherwise is memcpy (which only ever copies forwards).
+ * - strlen and strcmp work a word (or 16 bytes with SSE2) at a time.
+ *   Loads stay aligned, so they never cross into an unmapped page.
+ *
+ * The SSE2 versions are only picked (by cpu_init()) on CPUs that have it,
+ * and never inside IRQ handlers, which do not save the XMM registers.
+ * ============================================================================
+ */
+
+#include "kernel.h"
+#include "cpu.h"
+#include "interrupt.h"
+#include "memory.h"
+#include "screen.h"
+#include "printf.h"
+#include "timer.h"
+
+/* Size thresholds */
+#define MEM_SSE_MIN   128             /* Use the SSE2 loops from here */
+#define MEM_NT_MIN    (256 * 1024)    /* Roughly the L2 size: stream past it */
+
+/* Bit 7 of a byte is set where a byte of x is zero */
+#define ZERO_BYTES(x) (((x) - 0x01010101) & ~(x) & 0x80808080)
+
+/*
+ * XMM registers the SSE2 asm uses. GCC only accepts them as clobbers when
+ * SSE codegen is on, and only then could it keep values in them.
+ */
+#ifdef __SSE__
+#define XMM_CLOBBERS1 , "xmm0"
+#define XMM_CLOBBERS4 , "xmm0", "xmm1", "xmm2", "xmm3"
+#else
+#define XMM_CLOBBERS1
+#define XMM_CLOBBERS4
+#endif
+
+/* Word view of a byte buffer */
+typedef uint32_t __attribute__((may_alias)) word_t;
+
+/* ============================================================================
+ * Internal Functions
+ * ============================================================================ */
+
+/* Copy n bytes forwards with rep movsd and rep movsb */
+static void rep_copy(uint8_t* d, const uint8_t* s, size_t n) {
+    size_t words = n >> 2;
+    size_t bytes = n & 3;
+    __asm__ volatile ("rep movsl\n\t"
+                      "mov %3, %%ecx\n\t"
+                      "rep movsb"
+                      : "+D"(d), "+S"(s), "+c"(words)
+                      : "r"(bytes)
+                      : "memory");
+}
+
+/* Fill n bytes with rep stosd and rep stosb (v is the byte repeated 4x) */
+static void rep_fill(uint8_t* d, uint32_t v, size_t n) {
+    size_t words = n >> 2;
+    size_t bytes = n & 3;
+    __asm__ volatile ("rep stosl\n\t"
+                      "mov %3, %%ecx\n\t"
+                      "rep stosb"
+                      : "+D"(d), "+c"(words)
+                      : "a"(v), "r"(bytes)
+                      : "memory");
+}
+
+/* Copy 64-byte blocks forwards; d must be 16-byte aligned */
+static void sse_copy(uint8_t* d, const uint8_t* s, size_t blocks, bool stream) {
+    if (stream) {
+        __asm__ volatile ("1:\n\t"
+                          "movdqu   (%1), %%xmm0\n\t"
+                          "movdqu 16(%1), %%xmm1\n\t"
+                          "movdqu 32(%1), %%xmm2\n\t"
+                          "movdqu 48(%1), %%xmm3\n\t"
+                          "movntdq %%xmm0,   (%0)\n\t"
+                          "movntdq %%xmm1, 16(%0)\n\t"
+                          "movntdq %%xmm2, 32(%0)\n\t"
+                          "movntdq %%xmm3, 48(%0)\n\t"
+                          "add $64, %1\n\t"
+                          "add $64, %0\n\t"
+                          "dec %2\n\t"
+                          "jnz 1b\n\t"
+                          "sfence"
+                          : "+r"(d), "+r"(s), "+r"(blocks)
+                          :
+                          : "memory" XMM_CLOBBERS4);
+    } else {
+        __asm__ volatile ("1:\n\t"
+                          "movdqu   (%1), %%xmm0\n\t"
+                          "movdqu 16(%1), %%xmm1\n\t"
+                          "movdqu 32(%1), %%xmm2\n\t"
+                          "movdqu 48(%1), %%xmm3\n\t"
+                          "movdqa %%xmm0,   (%0)\n\t"
+                          "movdqa %%xmm1, 16(%0)\n\t"
+                          "movdqa %%xmm2, 32(%0)\n\t"
+                          "movdqa %%xmm3, 48(%0)\n\t"
+                          "add $64, %1\n\t"
+                          "add $64, %0\n\t"
+                          "dec %2\n\t"
+                          "jnz 1b"
+                          : "+r"(d), "+r"(s), "+r"(blocks)
+                          :
+                          : "memory" XMM_CLOBBERS4);
+    }
+}
+
+/* Copy 64-byte blocks backwards, ending at d and s; d must be 16-byte aligned */
+static void sse_copy_back(uint8_t* d, const uint8_t* s, size_t blocks) {
+    __asm__ volatile ("1:\n\t"
+                      "sub $64, %1\n\t"
+                      "sub $64, %0\n\t"
+                      "movdqu 48(%1), %%xmm3\n\t"
+                      "movdqu 32(%1), %%xmm2\n\t"
+                      "movdqu 16(%1), %%xmm1\n\t"
+                      "movdqu   (%1), %%xmm0\n\t"
+                      "movdqa %%xmm3, 48(%0)\n\t"
+                      "movdqa %%xmm2, 32(%0)\n\t"
+                      "movdqa %%xmm1, 16(%0)\n\t"
+                      "movdqa %%xmm0,   (%0)\n\t"
+                      "dec %2\n\t"
+                      "jnz 1b"
+                      : "+r"(d), "+r"(s), "+r"(blocks)
+                      :
+                      : "memory" XMM_CLOBBERS4);
+}
+
+/* Fill 64-byte blocks with v; d must be 16-byte aligned */
+static void sse_fill(uint8_t* d, uint32_t v, size_t blocks, bool stream) {
+    if (stream) {
+        __asm__ volatile ("movd %2, %%xmm0\n\t"
+                          "pshufd $0, %%xmm0, %%xmm0\n\t"
+                          "1:\n\t"
+                          "movntdq %%xmm0,   (%0)\n\t"
+                          "movntdq %%xmm0, 16(%0)\n\t"
+                          "movntdq %%xmm0, 32(%0)\n\t"
+                          "movntdq %%xmm0, 48(%0)\n\t"
+                          "add $64, %0\n\t"
+                          "dec %1\n\t"
+                          "jnz 1b\n\t"
+                          "sfence"
+                          : "+r"(d), "+r"(blocks)
+                          : "r"(v)
+                          : "memory" XMM_CLOBBERS1);
+    } else {
+        __asm__ volatile ("movd %2, %%xmm0\n\t"
+                          "pshufd $0, %%xmm0, %%xmm0\n\t"
+                          "1:\n\t"
+                          "movdqa %%xmm0,   (%0)\n\t"
+                          "movdqa %%xmm0, 16(%0)\n\t"
+                          "movdqa %%xmm0, 32(%0)\n\t"
+                          "movdqa %%xmm0, 48(%0)\n\t"
+                          "add $64, %0\n\t"
+                          "dec %1\n\t"
+                          "jnz 1b"
+                          : "+r"(d), "+r"(blocks)
+                          : "r"(v)
+                          : "memory" XMM_CLOBBERS1);
+    }
+}
+
+/* Copy forwards, with SSE2 block moves if sse2 is set */
+static void* copy(void* dest, const void* src, size_t num, bool sse2) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+
+    if (sse2 && num >= MEM_SSE_MIN) {
+        size_t head = -(uint32_t)d & 15;
+        rep_copy(d, s, head);
+        d += head;
+        s += head;
+        num -= head;
+
+        size_t blocks = num >> 6;
+        sse_copy(d, s, blocks, num >= MEM_NT_MIN);
+        d += blocks << 6;
+        s += blocks << 6;
+        num &= 63;
+    }
+
+    rep_copy(d, s, num);
+    return dest;
+}
+
+/* Copy possibly overlapping regions */
+static void* move(void* dest, const void* src, size_t num, bool sse2) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+
+    /* Forward copying is safe unless dest starts inside src */
+    if (d <= s || d >= s + num) {
+        return copy(dest, src, num, sse2);
+    }
+
+    d += num;
+    s += num;
+
+    if (sse2 && num >= MEM_SSE_MIN) {
+        size_t tail = (uint32_t)d & 15;
+        num -= tail;
+        while (tail--) *--d = *--s;
+
+        size_t blocks = num >> 6;
+        sse_copy_back(d, s, blocks);
+        d -= blocks << 6;
+        s -= blocks << 6;
+        num &= 63;
+    }
+
+    while (num >= 4) {
+        d -= 4;
+        s -= 4;
+        *(word_t*)d = *(const word_t*)s;
+        num -= 4;
+    }
+    while (num--) *--d = *--s;
+    return dest;
+}
+
+/* Fill with a byte value */
+static void* fill(void* ptr, int value, size_t num, bool sse2) {
+    uint8_t* d = (uint8_t*)ptr;
+    uint32_t v = (uint8_t)value * 0x01010101;
+
+    if (sse2 && num >= MEM_SSE_MIN) {
+        size_t head = -(uint32_t)d & 15;
+        rep_fill(d, v, head);
+        d += head;
+        num -= head;
+
+        size_t blocks = num >> 6;
+        sse_fill(d, v, blocks, num >= MEM_NT_MIN);
+        d += blocks << 6;
+        num &= 63;
+    }
+
+    rep_fill(d, v, num);
+    return ptr;
+}
+
+/* ============================================================================
+ * Implementations (selected through kernel_ops, see cpu.c)
+ * ============================================================================ */
+
+void* memcpy_generic(void* dest, const void* src, size_t num) {
+    return copy(dest, src, num, false);
+}
+
+void* memcpy_sse2(void* dest, const void* src, size_t num) {
+    return copy(dest, src, num, true);
+}
+
+void* memmove_generic(void* dest, const void* src, size_t num) {
+    return move(dest, src, num, false);
+}
+
+void* memmove_sse2(void* dest, const void* src, size_t num) {
+    return move(dest, src, num, true);
+}
+
+void* memset_generic(void* ptr, int value, size_t num) {
+    return fill(ptr, value, num, false);
+}
+
+void* memset_sse2(void* ptr, int value, size_t num) {
+    return fill(ptr, value, num, true);
+}
+
+size_t strlen_generic(const char* str) {
+    const char* p = str;
+    while ((uint32_t)p & 3) {
+        if (!*p) return p - str;
+        p++;
+    }
+
+    const word_t* w = (const word_t*)p;
+    while (!ZERO_BYTES(*w)) w++;
+
+    p = (const char*)w;
+    while (*p) p++;
+    return p - str;
+}
+
+size_t strlen_sse2(const char* str) {
+    /* Scan the aligned 16-byte blocks, ignoring bytes before str */
+    const char* p = (const char*)((uint32_t)str & ~15);
+    uint32_t mask;
+    __asm__ volatile ("pxor %%xmm0, %%xmm0\n\t"
+                      "pcmpeqb (%1), %%xmm0\n\t"
+                      "pmovmskb %%xmm0, %0"
+                      : "=r"(mask)
+                      : "r"(p)
+                      : "memory" XMM_CLOBBERS1);
+    mask >>= str - p;
+    if (mask) return __builtin_ctz(mask);
+
+    __asm__ volatile ("1:\n\t"
+                      "add $16, %1\n\t"
+                      "pxor %%xmm0, %%xmm0\n\t"
+                      "pcmpeqb (%1), %%xmm0\n\t"
+                      "pmovmskb %%xmm0, %0\n\t"
+                      "test %0, %0\n\t"
+                      "jz 1b"
+                      : "=r"(mask), "+r"(p)
+                      :
+                      : "memory" XMM_CLOBBERS1);
+    return p - str + __builtin_ctz(mask);
+}
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================ */
+
+/* Copy memory (regions must not overlap unless dest is below src) */
+void* memcpy(void* dest, const void* src, size_t num) {
+    if (in_interrupt()) return memcpy_generic(dest, src, num);
+    return kernel_ops.memcpy(dest, src, num);
+}
+
+/* Copy memory; the regions may overlap */
+void* memmove(void* dest, const void* src, size_t num) {
+    if (in_interrupt()) return memmove_generic(dest, src, num);
+    return kernel_ops.memmove(dest, src, num);
+}
+
+/* Fill memory with a byte value */
+void* memset(void* ptr, int value, size_t num) {
+    if (in_interrupt()) return memset_generic(ptr, value, num);
+    return kernel_ops.memset(ptr, value, num);
+}
+
+/* String length */
+size_t strlen(const char* str) {
+    if (in_interrupt()) return strlen_generic(str);
+    return kernel_ops.strlen(str);
+}
+
+/* String compare */
+int strcmp(const char* s1, const char* s2) {
+    /* Compare a word at a time when both strings share an alignment */
+    if ((((uint32_t)s1 ^ (uint32_t)s2) & 3) == 0) {
+        while ((uint32_t)s1 & 3) {
+            if (!*s1 || *s1 != *s2) {
+                return *(unsigned char*)s1 - *(unsigned char*)s2;
+            }
+            s1++;
+            s2++;
+        }
+
+        const word_t* w1 = (const word_t*)s1;
+        const word_t* w2 = (const word_t*)s2;
+        while (*w1 == *w2 && !ZERO_BYTES(*w1)) {
+            w1++;
+            w2++;
+        }
+        s1 = (const char*)w1;
+        s2 = (const char*)w2;
+    }
+
+    while (*s1 && (*s1 == *s2)) {
+        s1++;
+        s2++;
+    }
+    return *(unsigned char*)s1 - *(unsigned char*)s2;
+}
+
+/* ============================================================================
+ * Benchmark
+ * ============================================================================ */
+
+/* The byte-at-a-time versions these routines replaced */
+static void* byte_memcpy(void* dest, const void* src, size_t num) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+    while (num--) *d++ = *s++;
+    return dest;
+}
+
+static void* byte_memmove(void* dest, const void* src, size_t num) {
+    uint8_t* d = (uint8_t*)dest + num;
+    const uint8_t* s = (const uint8_t*)src + num;
+    while (num--) *--d = *--s;
+    return dest;
+}
+
+static void* byte_memset(void* ptr, int value, size_t num) {
+    uint8_t* p = (uint8_t*)ptr;
+    while (num--) *p++ = (uint8_t)value;
+    return ptr;
+}
+
+static size_t byte_strlen(const char* str) {
+    size_t len = 0;
+    while (str[len]) len++;
+    return len;
+}
+
+static int byte_strcmp(const char* s1, const char* s2) {
+    while (*s1 && (*s1 == *s2)) {
+        s1++;
+        s2++;
+    }
+    return *(unsigned char*)s1 - *(unsigned char*)s2;
+}
+
+#define BENCH_BYTES   (1024 * 1024)   /* Bytes processed per measurement */
+#define BENCH_SIZES   4
+
+static const uint32_t bench_sizes[BENCH_SIZES] = { 64, 4096, 65536, 1048576 };
+
+/* Cycles per KB for one routine at one size (volatile keeps calls alive) */
+static uint32_t bench_one(int op, bool fast, uint8_t* a, uint8_t* b, uint32_t size) {
+    volatile size_t sink = 0;
+    uint32_t reps = BENCH_BYTES / size;
+
+    uint64_t start = time_cycles();
+    for (uint32_t i = 0; i < reps; i++) {
+        switch (op) {
+            case 0: fast ? memcpy(a, b, size) : byte_memcpy(a, b, size); break;
+            case 1: fast ? memmove(a + 1, a, size) : byte_memmove(a + 1, a, size); break;
+            case 2: fast ? memset(a, i, size) : byte_memset(a, i, size); break;
+            case 3: sink += fast ? strlen((char*)b) : byte_strlen((char*)b); break;
+            case 4: sink += fast ? strcmp((char*)a, (char*)b)
+                                 : byte_strcmp((char*)a, (char*)b); break;
+        }
+    }
+    (void)sink;
+    return (uint32_t)((time_cycles() - start) >> 10);
+}
+
+/* Time each routine against the byte loop it replaced */
+void string_benchmark(void) {
+    static const char* names[] = { "memcpy", "memmove", "memset", "strlen", "strcmp" };
+
+    uint8_t* a = (uint8_t*)malloc(BENCH_BYTES + 64);
+    uint8_t* b = (uint8_t*)malloc(BENCH_BYTES + 64);
+    if (!a || !b) {
+        screen_print_color("Benchmark: out of memory\n", ERROR_COLOR);
+        free(a);
+        free(b);
+        return;
+    }
+
+    screen_print_color("\n=== Memory Routine Benchmark ===\n", INFO_COLOR);
+    kprintf("Cycles per KB, old byte loop / new (%s)\n", kernel_ops.level);
+    kprintf("%9s%-16s%-16s%-16s%s\n", "", "64 B", "4 KB", "64 KB", "1 MB");
+
+    for (int op = 0; op < 5; op++) {
+        kprintf("%-9s", names[op]);
+        for (int i = 0; i < BENCH_SIZES; i++) {
+            uint32_t size = bench_sizes[i];
+
+            /* Equal strings of size - 1 characters for strlen/strcmp */
+            memset(a, 'x', size);
+            memset(b, 'x', size);
+            a[size - 1] = '\0';
+            b[size - 1] = '\0';
+
+            uint32_t old_cycles = bench_one(op, false, a, b, size);
+            uint32_t new_cycles = bench_one(op, true, a, b, size);
+
+            char buf[16];
+            ksnprintf(buf, sizeof(buf), "%u/%u", old_cycles, new_cycles);
+            kprintf("%-16s", buf);
+        }
+        screen_print("\n");
+    }
+
+    free(a);
+    free(b);
+}
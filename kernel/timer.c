@@ -0,0 +1,180 @@
+/*
+ * ============================================================================
+ * Timer Implementation
+ * ============================================================================
+ * PIT channel 0 runs as a rate generator on IRQ 0; the handler only
+ * counts ticks. timer_init() then measures the TSC against the ticks
+ * for TIMER_CALIBRATE_MS, after which time_ns() has TSC resolution.
+ *
+ * Cycles become nanoseconds by a multiply and shift with a factor worked
+ * out once (ns = cycles * mult >> 24), so reading the clock needs no
+ * division.
+ *
+ * Reference: https://wiki.osdev.org/Programmable_Interval_Timer
+ * ============================================================================
+ */
+
+#include "timer.h"
+#include "cpu.h"
+#include "interrupt.h"
+#include "printf.h"
+#include "screen.h"
+
+/* PIT ports */
+#define PIT_CHANNEL0 0x40
+#define PIT_COMMAND  0x43
+
+/* Channel 0, low byte then high byte, mode 2 (rate generator), binary */
+#define PIT_CMD_CHANNEL0_RATE 0x34
+
+/* Fixed-point shift for the cycles to nanoseconds factor */
+#define CYCLES_SHIFT 24
+
+/* Below this the factor would not fit in 32 bits */
+#define MIN_TSC_KHZ 4000
+
+static volatile uint64_t ticks = 0;
+static uint32_t hz = 0;
+static uint32_t ns_per_tick = 0;
+
+/* TSC rate and conversion factor; tsc_khz is 0 if the TSC is not used */
+static uint32_t tsc_khz = 0;
+static uint32_t tsc_mult = 0;
+static uint64_t tsc_base = 0;
+
+/* ============================================================================
+ * Internal Functions
+ * ============================================================================ */
+
+static uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* IRQ 0 */
+static void timer_irq(InterruptFrame* frame) {
+    (void)frame;
+    ticks++;
+}
+
+/* Halt until the tick count reaches target */
+static void wait_ticks_until(uint64_t target) {
+    uint32_t flags = irq_save();
+    while (ticks < target) {
+        wait_for_interrupt();
+        interrupts_disable();
+    }
+    irq_restore(flags);
+}
+
+/* Count TSC cycles across TIMER_CALIBRATE_MS worth of ticks */
+static void calibrate_tsc(void) {
+    uint32_t count = (TIMER_CALIBRATE_MS * hz + 999) / 1000;
+
+    /* Start on a tick edge */
+    wait_ticks_until(timer_ticks() + 1);
+    uint64_t start = rdtsc();
+    uint64_t first = timer_ticks();
+    wait_ticks_until(first + count);
+    uint64_t cycles = rdtsc() - start;
+
+    /* kHz = cycles / (count * ns_per_tick / 10^6) */
+    uint32_t khz = (uint32_t)udiv64(cycles * 1000000, count * ns_per_tick, NULL);
+    if (khz < MIN_TSC_KHZ) return;
+
+    tsc_mult = (uint32_t)udiv64(1000000ULL << CYCLES_SHIFT, khz, NULL);
+    tsc_khz = khz;
+}
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================ */
+
+/* Start the tick interrupt at about rate Hz and calibrate the TSC */
+void timer_init(uint32_t rate) {
+    if (rate < 19) rate = 19;               /* The divisor is 16 bits */
+    if (rate > PIT_FREQUENCY) rate = PIT_FREQUENCY;
+
+    uint32_t divisor = (PIT_FREQUENCY + rate / 2) / rate;
+    if (divisor > 0xFFFF) divisor = 0xFFFF;
+
+    ticks = 0;
+    hz = PIT_FREQUENCY / divisor;
+    ns_per_tick = (uint32_t)udiv64((uint64_t)divisor * 1000000000, PIT_FREQUENCY, NULL);
+    tsc_khz = 0;
+    tsc_mult = 0;
+
+    port_byte_out(PIT_COMMAND, PIT_CMD_CHANNEL0_RATE);
+    port_byte_out(PIT_CHANNEL0, divisor & 0xFF);
+    port_byte_out(PIT_CHANNEL0, divisor >> 8);
+    irq_register(IRQ_TIMER, timer_irq);
+
+    if (cpu_has(CPU_TSC)) {
+        calibrate_tsc();
+    }
+    tsc_base = time_cycles();
+    ticks = 0;
+}
+
+/* Tick rate actually programmed */
+uint32_t timer_hz(void) {
+    return hz;
+}
+
+/* Ticks since timer_init() */
+uint64_t timer_ticks(void) {
+    uint32_t flags = irq_save();
+    uint64_t now = ticks;
+    irq_restore(flags);
+    return now;
+}
+
+/* Measured TSC frequency in kHz (0 if not used) */
+uint32_t timer_tsc_khz(void) {
+    return tsc_khz;
+}
+
+uint64_t time_cycles(void) {
+    return cpu_has(CPU_TSC) ? rdtsc() : 0;
+}
+
+/* Convert TSC cycles to nanoseconds (0 without a calibrated TSC) */
+uint64_t cycles_to_ns(uint64_t cycles) {
+    /* 96-bit product: (high * 2^32 + low) * mult >> CYCLES_SHIFT */
+    uint64_t high = (cycles >> 32) * tsc_mult;
+    uint64_t low = (cycles & 0xFFFFFFFF) * tsc_mult;
+    return (high << (32 - CYCLES_SHIFT)) + (low >> CYCLES_SHIFT);
+}
+
+uint64_t time_ns(void) {
+    if (tsc_khz) {
+        return cycles_to_ns(rdtsc() - tsc_base);
+    }
+    return timer_ticks() * ns_per_tick;
+}
+
+/* Milliseconds since timer_init() (wraps after 49 days) */
+uint32_t time_ms(void) {
+    return (uint32_t)udiv64(time_ns(), 1000000, NULL);
+}
+
+void sleep_ms(uint32_t ms) {
+    uint32_t count = (uint32_t)udiv64((uint64_t)ms * hz + 999, 1000, NULL);
+    wait_ticks_until(timer_ticks() + count);
+}
+
+/* Print the tick rate, TSC frequency and uptime */
+void timer_dump(void) {
+    uint32_t ms = time_ms();
+
+    screen_print_color("\n=== Timer ===\n", INFO_COLOR);
+    kprintf("PIT:     %u Hz (%u ns per tick), %u ticks\n",
+            hz, ns_per_tick, (uint32_t)timer_ticks());
+    if (tsc_khz) {
+        kprintf("TSC:     %u.%03u MHz\n", tsc_khz / 1000, tsc_khz % 1000);
+    } else {
+        screen_print("TSC:     not used\n");
+    }
+    kprintf("Uptime:  %u.%03u s\n", ms / 1000, ms % 1000);
+}
@@ -0,0 +1,44 @@
+/*
+ * ============================================================================
+ * Timer Header
+ * ============================================================================
+ * PIT tick interrupt, TSC calibration and the kernel clock
+ * ============================================================================
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "kernel.h"
+
+/* PIT input clock */
+#define PIT_FREQUENCY      1193182
+
+/* Tick rate used at boot */
+#define TIMER_DEFAULT_HZ   1000
+
+/* How long timer_init() spends measuring the TSC */
+#define TIMER_CALIBRATE_MS 50
+
+/* Timer Functions */
+void timer_init(uint32_t hz);
+uint32_t timer_hz(void);
+uint64_t timer_ticks(void);
+uint32_t timer_tsc_khz(void);
+
+/*
+ * Monotonic time since timer_init(). time_ns() uses the calibrated TSC
+ * when there is one, otherwise it counts whole ticks. time_cycles() is
+ * the raw TSC (0 without one), for measuring short stretches of code.
+ */
+uint64_t time_ns(void);
+uint32_t time_ms(void);
+uint64_t time_cycles(void);
+uint64_t cycles_to_ns(uint64_t cycles);
+
+/* Sleep with the CPU halted between ticks (needs interrupts enabled) */
+void sleep_ms(uint32_t ms);
+
+void timer_dump(void);
+
+#endif /* TIMER_H */
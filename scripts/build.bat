@@ -42,6 +42,11 @@ if %ERRORLEVEL% neq 0 (
     echo [ERROR] Failed to assemble kernel entry!
     exit /b 1
 )
+nasm -f elf32 kernel\isr.asm -o build\isr.o
+if %ERRORLEVEL% neq 0 (
+    echo [ERROR] Failed to assemble interrupt stubs!
+    exit /b 1
+)
 echo       Done!
 
 REM Try different compiler options
@@ -87,12 +92,27 @@ exit /b 1
 
 :compile
 %CC% -ffreestanding -m32 -c kernel\kernel.c -o build\kernel.o -fno-pie -fno-stack-protector
+%CC% -ffreestanding -m32 -c kernel\cpu.c -o build\cpu.o -fno-pie -fno-stack-protector
+%CC% -ffreestanding -m32 -c kernel\interrupt.c -o build\interrupt.o -fno-pie -fno-stack-protector
+%CC% -ffreestanding -m32 -c kernel\bcache.c -o build\bcache.o -fno-pie -fno-stack-protector
+%CC% -ffreestanding -m32 -c kernel\pci.c -o build\pci.o -fno-pie -fno-stack-protector
+%CC% -ffreestanding -m32 -c kernel\timer.c -o build\timer.o -fno-pie -fno-stack-protector
+%CC% -ffreestanding -m32 -c kernel\string.c -o build\string.o -fno-pie -fno-stack-protector
+%CC% -ffreestanding -m32 -c kernel\printf.c -o build\printf.o -fno-pie -fno-stack-protector
 %CC% -ffreestanding -m32 -c kernel\screen.c -o build\screen.o -fno-pie -fno-stack-protector
 %CC% -ffreestanding -m32 -c kernel\keyboard.c -o build\keyboard.o -fno-pie -fno-stack-protector
+%CC% -ffreestanding -m32 -c kernel\serial.c -o build\serial.o -fno-pie -fno-stack-protector
 %CC% -ffreestanding -m32 -c kernel\filesystem.c -o build\filesystem.o -fno-pie -fno-stack-protector
 %CC% -ffreestanding -m32 -c kernel\shell.c -o build\shell.o -fno-pie -fno-stack-protector
 %CC% -ffreestanding -m32 -c kernel\memory.c -o build\memory.o -fno-pie -fno-stack-protector
+%CC% -ffreestanding -m32 -c kernel\memmap.c -o build\memmap.o -fno-pie -fno-stack-protector
+%CC% -ffreestanding -m32 -c kernel\buddy.c -o build\buddy.o -fno-pie -fno-stack-protector
+%CC% -ffreestanding -m32 -c kernel\paging.c -o build\paging.o -fno-pie -fno-stack-protector
+%CC% -ffreestanding -m32 -c kernel\slab.c -o build\slab.o -fno-pie -fno-stack-protector
+%CC% -ffreestanding -m32 -c kernel\arena.c -o build\arena.o -fno-pie -fno-stack-protector
 %CC% -ffreestanding -m32 -c kernel\math.c -o build\math.o -fno-pie -fno-stack-protector
+REM SSE kernels: only called when cpu_init() finds SSE2
+%CC% -ffreestanding -m32 -c kernel\simd.c -o build\simd.o -fno-pie -fno-stack-protector -msse -msse2 -mfpmath=sse -mstackrealign
 %CC% -ffreestanding -m32 -c kernel\ata.c -o build\ata.o -fno-pie -fno-stack-protector
 
 if %ERRORLEVEL% neq 0 (
@@ -102,7 +122,7 @@ if %ERRORLEVEL% neq 0 (
 echo       Done!
 
 echo [4/5] Linking kernel...
-%LD% -o build\kernel.bin -T kernel\linker.ld build\kernel_entry.o build\kernel.o build\screen.o build\keyboard.o build\filesystem.o build\shell.o build\memory.o build\math.o build\ata.o --oformat binary -m elf_i386
+%LD% -o build\kernel.bin -T kernel\linker.ld build\kernel_entry.o build\isr.o build\kernel.o build\cpu.o build\interrupt.o build\bcache.o build\pci.o build\timer.o build\string.o build\printf.o build\screen.o build\keyboard.o build\serial.o build\filesystem.o build\shell.o build\memory.o build\memmap.o build\buddy.o build\paging.o build\slab.o build\arena.o build\math.o build\simd.o build\ata.o --oformat binary -m elf_i386
 if %ERRORLEVEL% neq 0 (
     echo [ERROR] Failed to link kernel!
     exit /b 1
@@ -34,24 +34,41 @@ nasm -f bin boot/boot.asm -o build/boot.bin
 
 echo "[2/5] Assembling kernel entry..."
 nasm -f elf32 kernel/kernel_entry.asm -o build/kernel_entry.o
+nasm -f elf32 kernel/isr.asm -o build/isr.o
 
 echo "[3/5] Compiling kernel..."
 # Added -std=gnu99 to avoid C23 'bool' keyword conflict
 CFLAGS="-ffreestanding -m32 -std=gnu99 -fno-pie -fno-stack-protector"
+# SSE kernels: only called when cpu_init() finds SSE2
+SIMD_CFLAGS="$CFLAGS -msse -msse2 -mfpmath=sse -mstackrealign"
 
 $CC $CFLAGS -c kernel/kernel.c -o build/kernel.o
+$CC $CFLAGS -c kernel/cpu.c -o build/cpu.o
+$CC $CFLAGS -c kernel/interrupt.c -o build/interrupt.o
+$CC $CFLAGS -c kernel/bcache.c -o build/bcache.o
+$CC $CFLAGS -c kernel/pci.c -o build/pci.o
+$CC $CFLAGS -c kernel/timer.c -o build/timer.o
+$CC $CFLAGS -c kernel/string.c -o build/string.o
+$CC $CFLAGS -c kernel/printf.c -o build/printf.o
 $CC $CFLAGS -c kernel/screen.c -o build/screen.o
 $CC $CFLAGS -c kernel/keyboard.c -o build/keyboard.o
+$CC $CFLAGS -c kernel/serial.c -o build/serial.o
 $CC $CFLAGS -c kernel/filesystem.c -o build/filesystem.o
 $CC $CFLAGS -c kernel/shell.c -o build/shell.o
 $CC $CFLAGS -c kernel/memory.c -o build/memory.o
+$CC $CFLAGS -c kernel/memmap.c -o build/memmap.o
+$CC $CFLAGS -c kernel/buddy.c -o build/buddy.o
+$CC $CFLAGS -c kernel/paging.c -o build/paging.o
+$CC $CFLAGS -c kernel/slab.c -o build/slab.o
+$CC $CFLAGS -c kernel/arena.c -o build/arena.o
 $CC $CFLAGS -c kernel/math.c -o build/math.o
+$CC $SIMD_CFLAGS -c kernel/simd.c -o build/simd.o
 $CC $CFLAGS -c kernel/ata.c -o build/ata.o
 
 echo "[4/5] Linking kernel..."
 $LD -o build/kernel.bin -T kernel/linker.ld \
-    build/kernel_entry.o build/kernel.o build/screen.o \
-    build/keyboard.o build/filesystem.o build/shell.o build/memory.o build/math.o build/ata.o \
+    build/kernel_entry.o build/isr.o build/kernel.o build/cpu.o build/interrupt.o build/bcache.o build/pci.o build/timer.o build/string.o build/printf.o build/screen.o \
+    build/keyboard.o build/serial.o build/filesystem.o build/shell.o build/memory.o build/memmap.o build/buddy.o build/paging.o build/slab.o build/arena.o build/math.o build/simd.o build/ata.o \
     --oformat binary -m elf_i386
 
 echo "[5/5] Creating OS image..."